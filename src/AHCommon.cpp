@@ -6,6 +6,117 @@
 
 namespace ah {
 
+namespace core {
+
+#ifndef METAMODULE
+
+TraceWriter &TraceWriter::instance() {
+	static TraceWriter writer;
+	return writer;
+}
+
+void TraceWriter::add(TraceRing *ring, int64_t moduleId, const std::string &slug, const char *const *names, int nNames) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	for (Source &source : sources) {
+		if (source.ring == ring) {
+			return;
+		}
+	}
+
+	Source source;
+	source.ring = ring;
+	source.moduleId = moduleId;
+	source.slug = slug;
+	source.names = names;
+	source.nNames = nNames;
+	source.reportedOverflows = ring->overflows.load(std::memory_order_relaxed);
+	sources.push_back(source);
+
+	if (!running) {
+		running = true;
+		thread = std::thread(&TraceWriter::run, this);
+	}
+}
+
+void TraceWriter::remove(TraceRing *ring) {
+	std::lock_guard<std::mutex> lock(mutex);
+	for (size_t i = 0; i < sources.size(); i++) {
+		if (sources[i].ring == ring) {
+			drain(sources[i]);
+			sources.erase(sources.begin() + i);
+			return;
+		}
+	}
+}
+
+TraceWriter::~TraceWriter() {
+	running = false;
+	if (thread.joinable()) {
+		thread.join();
+	}
+	if (file) {
+		fclose(file);
+	}
+}
+
+void TraceWriter::run() {
+	while (running) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (Source &source : sources) {
+				drain(source);
+			}
+			if (file) {
+				fflush(file);
+			}
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	}
+}
+
+// Called with the mutex held
+void TraceWriter::drain(Source &source) {
+
+	if (!file) {
+		file = fopen(asset::user("AmalgamatedHarmonics-trace.txt").c_str(), "a");
+		if (!file) {
+			return;
+		}
+	}
+
+	TraceRecord r;
+	while (source.ring->pop(r)) {
+
+		fprintf(file, "%d %s %lld ", r.stepX, source.slug.c_str(), (long long)source.moduleId);
+
+		if (r.event == TRACE_DROPPED_EVENTS) {
+			fprintf(file, "Dropped param events");
+		} else if (r.event >= 0 && r.event < source.nNames) {
+			fprintf(file, "%s", source.names[r.event]);
+		} else {
+			fprintf(file, "Event %d", r.event);
+		}
+
+		for (int i = 0; i < r.nValues; i++) {
+			fprintf(file, " %g", r.values[i]);
+		}
+		fprintf(file, "\n");
+
+	}
+
+	uint32_t overflows = source.ring->overflows.load(std::memory_order_relaxed);
+	if (overflows != source.reportedOverflows) {
+		fprintf(file, "- %s %lld Dropped %u trace records\n", source.slug.c_str(), (long long)source.moduleId, overflows - source.reportedOverflows);
+		source.reportedOverflows = overflows;
+	}
+
+}
+
+#endif
+
+} // namespace core
+
 namespace digital {
 
 int sgn(double v, double e) {
@@ -158,108 +269,6 @@ void Chord::setVoltages(const std::vector<int> &chordArray, int offset) {
 	}
 }
 
-ChordDef ChordTable[NUM_CHORDS] { // Move to Legacy module
-	{	0	,"None",	{	-24	,	-24	,	-24	,	-24	,	-24	,	-24	},{	-24	,	-24	,	-24	,	-24	,	-24	,	-24	},{	-24	,	-24	,	-24	,	-24	,	-24	,	-24	}},
-	{	1	,"M",		{	0	,	4	,	7	,	-24	,	-20	,	-17	},{	12	,	4	,	7	,	-12	,	-20	,	-17	},{	12	,	16	,	7	,	-12	,	-8	,	-17	}},
-	{	2	,"M#5",		{	0	,	4	,	8	,	-24	,	-20	,	-16	},{	12	,	4	,	8	,	-12	,	-20	,	-16	},{	12	,	16	,	8	,	-12	,	-8	,	-16	}},
-	{	3	,"M#5add9",	{	0	,	4	,	8	,	14	,	-24	,	-20	},{	12	,	4	,	8	,	14	,	-24	,	-20	},{	12	,	16	,	8	,	14	,	-12	,	-20	}},
-	{	4	,"M13",		{	0	,	4	,	7	,	11	,	14	,	21	},{	12	,	4	,	7	,	11	,	14	,	21	},{	12	,	16	,	7	,	11	,	14	,	21	}},
-	{	5	,"M6",		{	0	,	4	,	7	,	21	,	-24	,	-20	},{	12	,	4	,	7	,	21	,	-24	,	-20	},{	12	,	16	,	7	,	21	,	-12	,	-20	}},
-	{	6	,"M6#11",	{	0	,	4	,	7	,	9	,	18	,	-24	},{	12	,	4	,	7	,	9	,	18	,	-24	},{	12	,	16	,	7	,	9	,	18	,	-24	}},
-	{	7	,"M6/9",	{	0	,	4	,	7	,	9	,	14	,	-24	},{	12	,	4	,	7	,	9	,	14	,	-24	},{	12	,	16	,	7	,	9	,	14	,	-24	}},
-	{	8	,"M6/9#11",	{	0	,	4	,	7	,	9	,	14	,	18	},{	12	,	4	,	7	,	9	,	14	,	18	},{	12	,	16	,	7	,	9	,	14	,	18	}},
-	{	9	,"M7#11",	{	0	,	4	,	7	,	11	,	18	,	-24	},{	12	,	4	,	7	,	11	,	18	,	-24	},{	12	,	16	,	7	,	11	,	18	,	-24	}},
-	{	10	,"M7#5",	{	0	,	4	,	8	,	11	,	-24	,	-20	},{	12	,	4	,	8	,	11	,	-24	,	-20	},{	12	,	16	,	8	,	11	,	-12	,	-20	}},
-	{	11	,"M7#5sus4",{	0	,	5	,	8	,	11	,	-24	,	-19	},{	12	,	5	,	8	,	11	,	-24	,	-19	},{	12	,	17	,	8	,	11	,	-12	,	-19	}},
-	{	12	,"M7#9#11",	{	0	,	4	,	7	,	11	,	15	,	18	},{	12	,	4	,	7	,	11	,	15	,	18	},{	12	,	16	,	7	,	11	,	15	,	18	}},
-	{	13	,"M7add13",	{	0	,	4	,	7	,	9	,	11	,	14	},{	12	,	4	,	7	,	9	,	11	,	14	},{	12	,	16	,	7	,	9	,	11	,	14	}},
-	{	14	,"M7b5",	{	0	,	4	,	6	,	11	,	-24	,	-20	},{	12	,	4	,	6	,	11	,	-24	,	-20	},{	12	,	16	,	6	,	11	,	-12	,	-20	}},
-	{	15	,"M7b6",	{	0	,	4	,	8	,	11	,	-24	,	-20	},{	12	,	4	,	8	,	11	,	-24	,	-20	},{	12	,	16	,	8	,	11	,	-12	,	-20	}},
-	{	16	,"M7b9",	{	0	,	4	,	7	,	11	,	13	,	-20	},{	12	,	4	,	7	,	11	,	13	,	-20	},{	12	,	16	,	7	,	11	,	13	,	-20	}},
-	{	17	,"M7sus4",	{	0	,	5	,	7	,	11	,	-24	,	-19	},{	12	,	5	,	7	,	11	,	-24	,	-19	},{	12	,	17	,	7	,	11	,	-12	,	-19	}},
-	{	18	,"M9",		{	0	,	4	,	7	,	11	,	14	,	-24	},{	12	,	4	,	7	,	11	,	14	,	-24	},{	12	,	16	,	7	,	11	,	14	,	-24	}},
-	{	19	,"M9#11",	{	0	,	4	,	7	,	11	,	14	,	18	},{	12	,	4	,	7	,	11	,	14	,	18	},{	12	,	16	,	7	,	11	,	14	,	18	}},
-	{	20	,"M9#5",	{	0	,	4	,	8	,	11	,	14	,	-24	},{	12	,	4	,	8	,	11	,	14	,	-24	},{	12	,	16	,	8	,	11	,	14	,	-24	}},
-	{	21	,"M9#5sus4",{	0	,	5	,	8	,	11	,	14	,	-24	},{	12	,	5	,	8	,	11	,	14	,	-24	},{	12	,	17	,	8	,	11	,	14	,	-24	}},
-	{	22	,"M9b5",	{	0	,	4	,	6	,	11	,	14	,	-24	},{	12	,	4	,	6	,	11	,	14	,	-24	},{	12	,	16	,	6	,	11	,	14	,	-24	}},
-	{	23	,"M9sus4",	{	0	,	5	,	7	,	11	,	14	,	-24	},{	12	,	5	,	7	,	11	,	14	,	-24	},{	12	,	17	,	7	,	11	,	14	,	-24	}},
-	{	24	,"Madd9",	{	0	,	4	,	7	,	14	,	-24	,	-20	},{	12	,	4	,	7	,	14	,	-24	,	-20	},{	12	,	16	,	7	,	14	,	-12	,	-20	}},
-	{	25	,"Maj7",	{	0	,	4	,	7	,	11	,	-24	,	-20	},{	12	,	4	,	7	,	11	,	-24	,	-20	},{	12	,	16	,	7	,	11	,	-12	,	-20	}},
-	{	26	,"Mb5",		{	0	,	4	,	6	,	-24	,	-20	,	-18	},{	12	,	4	,	6	,	-12	,	-20	,	-18	},{	12	,	16	,	6	,	-12	,	-8	,	-18	}},
-	{	27	,"Mb6",		{	0	,	4	,	20	,	-24	,	-20	,	-4	},{	12	,	4	,	20	,	-12	,	-20	,	-4	},{	12	,	16	,	20	,	-12	,	-8	,	-4	}},
-	{	28	,"Msus2",	{	0	,	2	,	7	,	-24	,	-22	,	-17	},{	12	,	2	,	7	,	-12	,	-22	,	-17	},{	12	,	14	,	7	,	-12	,	-10	,	-17	}},
-	{	29	,"Msus4",	{	0	,	5	,	7	,	-24	,	-19	,	-17	},{	12	,	5	,	7	,	-12	,	-19	,	-17	},{	12	,	17	,	7	,	-12	,	-7	,	-17	}},
-	{	30	,"Maddb9",	{	0	,	4	,	7	,	13	,	-24	,	-20	},{	12	,	4	,	7	,	13	,	-24	,	-20	},{	12	,	16	,	7	,	13	,	-12	,	-20	}},
-	{	31	,"7",		{	0	,	4	,	7	,	10	,	-24	,	-20	},{	12	,	4	,	7	,	10	,	-24	,	-20	},{	12	,	16	,	7	,	10	,	-12	,	-20	}},
-	{	32	,"9",		{	0	,	4	,	7	,	10	,	14	,	-24	},{	12	,	4	,	7	,	10	,	14	,	-24	},{	12	,	16	,	7	,	10	,	14	,	-24	}},
-	{	33	,"11",		{	0	,	7	,	10	,	14	,	17	,	-24	},{	12	,	7	,	10	,	14	,	17	,	-24	},{	12	,	19	,	10	,	14	,	17	,	-24	}},
-	{	34	,"13",		{	0	,	4	,	7	,	10	,	14	,	21	},{	12	,	4	,	7	,	10	,	14	,	21	},{	12	,	16	,	7	,	10	,	14	,	21	}},
-	{	35	,"11b9",	{	0	,	7	,	10	,	13	,	17	,	-24	},{	12	,	7	,	10	,	13	,	17	,	-24	},{	12	,	19	,	10	,	13	,	17	,	-24	}},
-	{	36	,"13#9",	{	0	,	4	,	7	,	10	,	15	,	21	},{	12	,	4	,	7	,	10	,	15	,	21	},{	12	,	16	,	7	,	10	,	15	,	21	}},
-	{	37	,"13b5",	{	0	,	4	,	6	,	9	,	10	,	14	},{	12	,	4	,	6	,	9	,	10	,	14	},{	12	,	16	,	6	,	9	,	10	,	14	}},
-	{	38	,"13b9",	{	0	,	4	,	7	,	10	,	13	,	21	},{	12	,	4	,	7	,	10	,	13	,	21	},{	12	,	16	,	7	,	10	,	13	,	21	}},
-	{	39	,"13no5",	{	0	,	4	,	10	,	14	,	21	,	-24	},{	12	,	4	,	10	,	14	,	21	,	-24	},{	12	,	16	,	10	,	14	,	21	,	-24	}},
-	{	40	,"13sus4",	{	0	,	5	,	7	,	10	,	14	,	21	},{	12	,	5	,	7	,	10	,	14	,	21	},{	12	,	17	,	7	,	10	,	14	,	21	}},
-	{	41	,"69#11",	{	0	,	4	,	7	,	9	,	14	,	18	},{	12	,	4	,	7	,	9	,	14	,	18	},{	12	,	16	,	7	,	9	,	14	,	18	}},
-	{	42	,"7#11",	{	0	,	4	,	7	,	10	,	18	,	-24	},{	12	,	4	,	7	,	10	,	18	,	-24	},{	12	,	16	,	7	,	10	,	18	,	-24	}},
-	{	43	,"7#11b13",	{	0	,	4	,	7	,	10	,	18	,	20	},{	12	,	4	,	7	,	10	,	18	,	20	},{	12	,	16	,	7	,	10	,	18	,	20	}},
-	{	44	,"7#5",		{	0	,	4	,	8	,	10	,	-24	,	-20	},{	12	,	4	,	8	,	10	,	-24	,	-20	},{	12	,	16	,	8	,	10	,	-12	,	-20	}},
-	{	45	,"7#5#9",	{	0	,	4	,	8	,	10	,	15	,	-24	},{	12	,	4	,	8	,	10	,	15	,	-24	},{	12	,	16	,	8	,	10	,	15	,	-24	}},
-	{	46	,"7#5b9",	{	0	,	4	,	8	,	10	,	13	,	-24	},{	12	,	4	,	8	,	10	,	13	,	-24	},{	12	,	16	,	8	,	10	,	13	,	-24	}},
-	{	47	,"7#5b9#11",{	0	,	4	,	8	,	10	,	13	,	18	},{	12	,	4	,	8	,	10	,	13	,	18	},{	12	,	16	,	8	,	10	,	13	,	18	}},
-	{	48	,"7#5sus4",	{	0	,	5	,	8	,	10	,	-24	,	-19	},{	12	,	5	,	8	,	10	,	-24	,	-19	},{	12	,	17	,	8	,	10	,	-12	,	-19	}},
-	{	49	,"7#9",		{	0	,	4	,	7	,	10	,	15	,	-24	},{	12	,	4	,	7	,	10	,	15	,	-24	},{	12	,	16	,	7	,	10	,	15	,	-24	}},
-	{	50	,"7#9#11",	{	0	,	4	,	7	,	10	,	15	,	18	},{	12	,	4	,	7	,	10	,	15	,	18	},{	12	,	16	,	7	,	10	,	15	,	18	}},
-	{	51	,"7#9b13",	{	0	,	4	,	7	,	10	,	15	,	20	},{	12	,	4	,	7	,	10	,	15	,	20	},{	12	,	16	,	7	,	10	,	15	,	20	}},
-	{	52	,"7add6",	{	0	,	4	,	7	,	10	,	21	,	-24	},{	12	,	4	,	7	,	10	,	21	,	-24	},{	12	,	16	,	7	,	10	,	21	,	-24	}},
-	{	53	,"7b13",	{	0	,	4	,	10	,	20	,	-24	,	-20	},{	12	,	4	,	10	,	20	,	-24	,	-20	},{	12	,	16	,	10	,	20	,	-12	,	-20	}},
-	{	54	,"7b5",		{	0	,	4	,	6	,	10	,	-24	,	-20	},{	12	,	4	,	6	,	10	,	-24	,	-20	},{	12	,	16	,	6	,	10	,	-12	,	-20	}},
-	{	55	,"7b6",		{	0	,	4	,	7	,	8	,	10	,	-24	},{	12	,	4	,	7	,	8	,	10	,	-24	},{	12	,	16	,	7	,	8	,	10	,	-24	}},
-	{	56	,"7b9",		{	0	,	4	,	7	,	10	,	13	,	-24	},{	12	,	4	,	7	,	10	,	13	,	-24	},{	12	,	16	,	7	,	10	,	13	,	-24	}},
-	{	57	,"7b9#11",	{	0	,	4	,	7	,	10	,	13	,	18	},{	12	,	4	,	7	,	10	,	13	,	18	},{	12	,	16	,	7	,	10	,	13	,	18	}},
-	{	58	,"7b9#9",	{	0	,	4	,	7	,	10	,	13	,	15	},{	12	,	4	,	7	,	10	,	13	,	15	},{	12	,	16	,	7	,	10	,	13	,	15	}},
-	{	59	,"7b9b13",	{	0	,	4	,	7	,	10	,	13	,	20	},{	12	,	4	,	7	,	10	,	13	,	20	},{	12	,	16	,	7	,	10	,	13	,	20	}},
-	{	60	,"7no5",	{	0	,	4	,	10	,	-24	,	-20	,	-14	},{	12	,	4	,	10	,	-12	,	-20	,	-14	},{	12	,	16	,	10	,	-12	,	-8	,	-14	}},
-	{	61	,"7sus4",	{	0	,	5	,	7	,	10	,	-24	,	-19	},{	12	,	5	,	7	,	10	,	-24	,	-19	},{	12	,	17	,	7	,	10	,	-12	,	-19	}},
-	{	62	,"7sus4b9",	{	0	,	5	,	7	,	10	,	13	,	-24	},{	12	,	5	,	7	,	10	,	13	,	-24	},{	12	,	17	,	7	,	10	,	13	,	-24	}},
-	{	63	,"7sus4b9b13",{	0	,	5	,	7	,	10	,	13	,	20	},{	12	,	5	,	7	,	10	,	13	,	20	},{	12	,	17	,	7	,	10	,	13	,	20	}},
-	{	64	,"9#11",	{	0	,	4	,	7	,	10	,	14	,	18	},{	12	,	4	,	7	,	10	,	14	,	18	},{	12	,	16	,	7	,	10	,	14	,	18	}},
-	{	65	,"9#5",		{	0	,	4	,	8	,	10	,	14	,	-24	},{	12	,	4	,	8	,	10	,	14	,	-24	},{	12	,	16	,	8	,	10	,	14	,	-24	}},
-	{	66	,"9#5#11",	{	0	,	4	,	8	,	10	,	14	,	18	},{	12	,	4	,	8	,	10	,	14	,	18	},{	12	,	16	,	8	,	10	,	14	,	18	}},
-	{	67	,"9b13",	{	0	,	4	,	10	,	14	,	20	,	-24	},{	12	,	4	,	10	,	14	,	20	,	-24	},{	12	,	16	,	10	,	14	,	20	,	-24	}},
-	{	68	,"9b5",		{	0	,	4	,	6	,	10	,	14	,	-24	},{	12	,	4	,	6	,	10	,	14	,	-24	},{	12	,	16	,	6	,	10	,	14	,	-24	}},
-	{	69	,"9no5",	{	0	,	4	,	10	,	14	,	-24	,	-20	},{	12	,	4	,	10	,	14	,	-24	,	-20	},{	12	,	16	,	10	,	14	,	-12	,	-20	}},
-	{	70	,"9sus4",	{	0	,	5	,	7	,	10	,	14	,	-24	},{	12	,	5	,	7	,	10	,	14	,	-24	},{	12	,	17	,	7	,	10	,	14	,	-24	}},
-	{	71	,"m",		{	0	,	3	,	7	,	-24	,	-21	,	-17	},{	12	,	3	,	7	,	-12	,	-21	,	-17	},{	12	,	15	,	7	,	-12	,	-9	,	-17	}},
-	{	72	,"m#5",		{	0	,	3	,	8	,	-24	,	-21	,	-16	},{	12	,	3	,	8	,	-12	,	-21	,	-16	},{	12	,	15	,	8	,	-12	,	-9	,	-16	}},
-	{	73	,"m11",		{	0	,	3	,	7	,	10	,	14	,	17	},{	12	,	3	,	7	,	10	,	14	,	17	},{	12	,	15	,	7	,	10	,	14	,	17	}},
-	{	74	,"m11A5",	{	0	,	3	,	8	,	10	,	14	,	17	},{	12	,	3	,	8	,	10	,	14	,	17	},{	12	,	15	,	8	,	10	,	14	,	17	}},
-	{	75	,"m11b5",	{	0	,	3	,	10	,	14	,	17	,	18	},{	12	,	3	,	10	,	14	,	17	,	18	},{	12	,	15	,	10	,	14	,	17	,	18	}},
-	{	76	,"m6",		{	0	,	3	,	5	,	7	,	21	,	-24	},{	12	,	3	,	5	,	7	,	21	,	-24	},{	12	,	15	,	5	,	7	,	21	,	-24	}},
-	{	77	,"m69",		{	0	,	3	,	7	,	9	,	14	,	-24	},{	12	,	3	,	7	,	9	,	14	,	-24	},{	12	,	15	,	7	,	9	,	14	,	-24	}},
-	{	78	,"m7",		{	0	,	3	,	7	,	10	,	-24	,	-21	},{	12	,	3	,	7	,	10	,	-24	,	-21	},{	12	,	15	,	7	,	10	,	-12	,	-21	}},
-	{	79	,"m7#5",	{	0	,	3	,	8	,	10	,	-24	,	-21	},{	12	,	3	,	8	,	10	,	-24	,	-21	},{	12	,	15	,	8	,	10	,	-12	,	-21	}},
-	{	80	,"m7add11",	{	0	,	3	,	7	,	10	,	17	,	-24	},{	12	,	3	,	7	,	10	,	17	,	-24	},{	12	,	15	,	7	,	10	,	17	,	-24	}},
-	{	81	,"m7b5",	{	0	,	3	,	6	,	10	,	-24	,	-21	},{	12	,	3	,	6	,	10	,	-24	,	-21	},{	12	,	15	,	6	,	10	,	-12	,	-21	}},
-	{	82	,"m9",		{	0	,	3	,	7	,	10	,	14	,	-24	},{	12	,	3	,	7	,	10	,	14	,	-24	},{	12	,	15	,	7	,	10	,	14	,	-24	}},
-	{	83	,"#5",		{	0	,	3	,	8	,	10	,	14	,	-24	},{	12	,	3	,	8	,	10	,	14	,	-24	},{	12	,	15	,	8	,	10	,	14	,	-24	}},
-	{	84	,"m9b5",	{	0	,	3	,	10	,	14	,	18	,	-24	},{	12	,	3	,	10	,	14	,	18	,	-24	},{	12	,	15	,	10	,	14	,	18	,	-24	}},
-	{	85	,"mMaj7",	{	0	,	3	,	7	,	11	,	-24	,	-21	},{	12	,	3	,	7	,	11	,	-24	,	-21	},{	12	,	15	,	7	,	11	,	-12	,	-21	}},
-	{	86	,"mMaj7b6",	{	0	,	3	,	7	,	8	,	11	,	-24	},{	12	,	3	,	7	,	8	,	11	,	-24	},{	12	,	15	,	7	,	8	,	11	,	-24	}},
-	{	87	,"mM9",		{	0	,	3	,	7	,	11	,	14	,	-24	},{	12	,	3	,	7	,	11	,	14	,	-24	},{	12	,	15	,	7	,	11	,	14	,	-24	}},
-	{	88	,"mM9b6",	{	0	,	3	,	7	,	8	,	11	,	14	},{	12	,	3	,	7	,	8	,	11	,	14	},{	12	,	15	,	7	,	8	,	11	,	14	}},
-	{	89	,"mb6M7",	{	0	,	3	,	8	,	11	,	-24	,	-21	},{	12	,	3	,	8	,	11	,	-24	,	-21	},{	12	,	15	,	8	,	11	,	-12	,	-21	}},
-	{	90	,"mb6b9",	{	0	,	3	,	8	,	13	,	-24	,	-21	},{	12	,	3	,	8	,	13	,	-24	,	-21	},{	12	,	15	,	8	,	13	,	-12	,	-21	}},
-	{	91	,"dim",		{	0	,	3	,	6	,	-24	,	-21	,	-18	},{	12	,	3	,	6	,	-12	,	-21	,	-18	},{	12	,	15	,	6	,	-12	,	-9	,	-18	}},
-	{	92	,"dim7",	{	0	,	3	,	6	,	21	,	-24	,	-21	},{	12	,	3	,	6	,	21	,	-24	,	-21	},{	12	,	15	,	6	,	21	,	-12	,	-21	}},
-	{	93	,"dim7M7",	{	0	,	3	,	6	,	9	,	11	,	-24	},{	12	,	3	,	6	,	9	,	11	,	-24	},{	12	,	15	,	6	,	9	,	11	,	-24	}},
-	{	94	,"dimM7",	{	0	,	3	,	6	,	11	,	-24	,	-21	},{	12	,	3	,	6	,	11	,	-24	,	-21	},{	12	,	15	,	6	,	11	,	-12	,	-21	}},
-	{	95	,"sus24",	{	0	,	2	,	5	,	7	,	-24	,	-22	},{	12	,	2	,	5	,	7	,	-24	,	-22	},{	12	,	14	,	5	,	7	,	-12	,	-22	}},
-	{	96	,"augadd#9",{	0	,	4	,	8	,	15	,	-24	,	-20	},{	12	,	4	,	8	,	15	,	-24	,	-20	},{	12	,	16	,	8	,	15	,	-12	,	-20	}},
-	{	97	,"madd4",	{	0	,	3	,	5	,	7	,	-24	,	-21	},{	12	,	3	,	5	,	7	,	-24	,	-21	},{	12	,	15	,	5	,	7	,	-12	,	-21	}},
-	{	98	,"madd9",	{	0	,	3	,	7	,	14	,	-24	,	-21	},{	12	,	3	,	7	,	14	,	-24	,	-21	},{	12	,	15	,	7	,	14	,	-12	,	-21	}},		
-};
-
 std::vector<ChordFormula> BasicChordSet {
 	{"M",			{	0	,	4	,	7}},
 	{"m",			{	0	,	3	,	7}},
@@ -899,6 +908,84 @@ const InversionDefinition &KnownChords::getChord(Chord currChord) {
 	return chords[currChord.chord].inversions[currChord.inversion];
 }
 
+// Note what is sounding without leading it, e.g. a chord replayed from a buffer
+void VoiceLeader::follow(const float *volts) {
+	for (int v = 0; v < NUM_VOICES; v++) {
+		previous[v] = volts[v];
+	}
+	havePrevious = true;
+}
+
+void VoiceLeader::lead(const float *volts, float *out) {
+
+	float placed[NUM_VOICES];
+
+	if (mode == OFF) {
+		for (int v = 0; v < NUM_VOICES; v++) {
+			placed[v] = volts[v];
+		}
+	} else {
+
+		// The first chord has nothing to lead from, so is only placed
+		int nRotations = havePrevious ? NUM_VOICES : 1;
+
+		float candidate[NUM_VOICES];
+		float bestMovement = INFINITY;
+		for (int r = 0; r < nRotations; r++) {
+			float movement = place(volts, r, candidate);
+			if (movement < bestMovement) {
+				bestMovement = movement;
+				std::memcpy(placed, candidate, sizeof(placed));
+			}
+		}
+
+	}
+
+	// out may be volts, so only written once every rotation has been tried
+	for (int v = 0; v < NUM_VOICES; v++) {
+		out[v] = placed[v];
+		previous[v] = placed[v];
+	}
+
+	havePrevious = true;
+
+}
+
+// Voice v takes note v + rotation of the chord, at the octave nearest the previous voice, returning how far the
+// voices move in total
+float VoiceLeader::place(const float *volts, int rotation, float *out) {
+
+	float movement = 0.0f;
+
+	for (int v = 0; v < NUM_VOICES; v++) {
+
+		float pitch = volts[(v + rotation) % NUM_VOICES];
+
+		// Nearest octave to the previous voice, or where it is for the first chord
+		if (havePrevious) {
+			pitch += roundf(previous[v] - pitch);
+		}
+
+		if (mode == CLOSEST_IN_RANGE) {
+			if (pitch < low) {
+				pitch += ceilf(low - pitch);
+			} else if (pitch > high) {
+				pitch -= ceilf(pitch - high);
+			}
+		}
+
+		if (havePrevious) {
+			movement += fabsf(pitch - previous[v]);
+		}
+
+		out[v] = pitch;
+
+	}
+
+	return movement;
+
+}
+
 } // music
 
 } // ah
\ No newline at end of file
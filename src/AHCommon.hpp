@@ -1,7 +1,14 @@
 #pragma once
 
+#include <atomic>
+#include <cstring>
 #include <iostream>
 
+#ifndef METAMODULE
+#include <mutex>
+#include <thread>
+#endif
+
 #include "AH.hpp"
 
 namespace ah {
@@ -12,6 +19,7 @@ const double PI = 3.14159265358979323846264338327950288;
 
 struct ParamEvent {
 
+	ParamEvent() : pType(-1), pId(0), value(0.0f) {}
 	ParamEvent(int t, int i, float v) : pType(t), pId(i), value(v) {}
 
 	int pType;
@@ -20,22 +28,389 @@ struct ParamEvent {
 
 };
 
+// The last param event and what the module made of it, published by the audio thread for StateDisplay to format on
+// the UI thread. All ints so that it has no padding to upset DisplaySnapshot's compare
+struct ParamState {
+	int keep;		// Cleared when the display times out
+	int pType;
+	int pId;
+	float value;
+	int detail[5];	// Module-specific, e.g. the chord the param picked
+};
+
+// Bounded single-producer/single-consumer queue. One thread pushes, another pops, and neither blocks or allocates.
+// When full, push() drops the item and counts it in overflows
+template <typename T, int CAPACITY>
+struct EventQueue {
+
+	static_assert((CAPACITY & (CAPACITY - 1)) == 0, "EventQueue capacity must be a power of 2");
+
+	T items[CAPACITY];
+	std::atomic<uint32_t> head {0}; // Next slot to pop, owned by the consumer
+	std::atomic<uint32_t> tail {0}; // Next slot to push, owned by the producer
+	std::atomic<uint32_t> overflows {0};
+
+	bool push(const T &item) {
+		uint32_t t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) >= (uint32_t)CAPACITY) {
+			overflows.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		items[t & (CAPACITY - 1)] = item;
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool pop(T &item) {
+		uint32_t h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire)) {
+			return false;
+		}
+		item = items[h & (CAPACITY - 1)];
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool empty() {
+		return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+	}
+
+};
+
+// Plain-old-data state published by the audio thread for widgets to draw from. The writer fills the idle buffer and then
+// bumps the sequence number; readers copy the current buffer and retry if a publish happened in the meantime
+template <typename T>
+struct DisplaySnapshot {
+
+	T buffers[2] = {};
+	std::atomic<uint32_t> sequence {0};
+
+	// Audio thread only
+	void publish(const T &state) {
+		uint32_t s = sequence.load(std::memory_order_relaxed);
+		if (std::memcmp(&buffers[s & 1], &state, sizeof(T)) == 0) {
+			return; // Nothing changed
+		}
+		buffers[(s + 1) & 1] = state;
+		sequence.store(s + 1, std::memory_order_release);
+	}
+
+	// Any thread
+	T read() {
+		while (true) {
+			uint32_t s = sequence.load(std::memory_order_acquire);
+			T state = buffers[s & 1];
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (sequence.load(std::memory_order_relaxed) == s) {
+				return state;
+			}
+		}
+	}
+
+};
+
+// Vector with inline, fixed-capacity storage for use on the audio thread. It never allocates; push_back() on a full
+// vector drops the item and returns false
+template <typename T, int CAPACITY>
+struct FixedVector {
+
+	T items[CAPACITY];
+	int n = 0;
+
+	inline void clear() {
+		n = 0;
+	}
+
+	inline bool push_back(const T &item) {
+		if (n >= CAPACITY) {
+			return false;
+		}
+		items[n++] = item;
+		return true;
+	}
+
+	inline size_t size() const {
+		return n;
+	}
+
+	inline bool empty() const {
+		return n == 0;
+	}
+
+	inline T &operator[](size_t i) {
+		return items[i];
+	}
+
+	inline const T &operator[](size_t i) const {
+		return items[i];
+	}
+
+	inline T *begin() {
+		return items;
+	}
+
+	inline T *end() {
+		return items + n;
+	}
+
+};
+
+// One trace entry, written by the audio thread and formatted to text later by the TraceWriter
+struct TraceRecord {
+	int32_t stepX;
+	int32_t event;
+	int32_t nValues;
+	float values[4];
+};
+
+static const int TRACE_SIZE = 4096;
+
+typedef EventQueue<TraceRecord, TRACE_SIZE> TraceRing;
+
+// Event codes below zero are reserved for AHModule itself
+enum TraceEvents {
+	TRACE_DROPPED_EVENTS = -1
+};
+
+#ifndef METAMODULE
+
+// Background thread that empties the trace rings of the modules with tracing on and appends them to
+// AmalgamatedHarmonics-trace.txt in the Rack user folder, so the audio thread never touches a file
+struct TraceWriter {
+
+	struct Source {
+		TraceRing *ring;
+		int64_t moduleId;
+		std::string slug;
+		const char *const *names;
+		int nNames;
+		uint32_t reportedOverflows;
+	};
+
+	static TraceWriter &instance();
+
+	void add(TraceRing *ring, int64_t moduleId, const std::string &slug, const char *const *names, int nNames);
+	void remove(TraceRing *ring);
+
+	~TraceWriter();
+
+	private:
+
+		void run();
+		void drain(Source &source);
+
+		std::mutex mutex;
+		std::vector<Source> sources;
+		std::thread thread;
+		std::atomic<bool> running {false};
+		FILE *file = NULL;
+
+};
+
+#endif
+
 struct AHModule : rack::Module {
 
 	AHModule(int numParams, int numInputs, int numOutputs, int numLights = 0) {
 		config(numParams, numInputs, numOutputs, numLights);
+		lightDivider.setDivision(LIGHT_DIVISION);
+
+		controlDivider.setDivision(CONTROL_DIVISION);
+		isControlParam.assign(numParams, false);
+		controlParams.assign(numParams, 0.0f);
+		controlInputIndex.assign(numInputs, -1);
+	}
+
+	// Lights are updated at control rate; modules only write their lights when lightsDue is set
+	static const int LIGHT_DIVISION = 64;
+
+	rack::dsp::ClockDivider lightDivider;
+	bool lightsDue = true;
+
+	void setLightDivision(int division) {
+		lightDivider.setDivision(division);
+	}
+
+	// Smoothing time for setSmoothBrightness, covering all the samples since the last light update
+	inline float lightTime(float sampleTime) {
+		return sampleTime * lightDivider.getDivision();
+	}
+
+	// Control-rate parameters and inputs. Modules opt in by declaring slow params and CV inputs in their
+	// constructor, after which they are latched every CONTROL_DIVISION samples and read back with
+	// getControlParam() and getControlInput(). Anything not declared (clocks, gates, resets) is still
+	// read at audio rate, and latchControls() re-samples immediately, e.g. on a clock edge.
+	// controlDue is set on the samples where the latched values were refreshed
+	static const int CONTROL_DIVISION = 16;
+
+	struct ControlInput {
+		int id;
+		int channels = 0;
+		float voltages[rack::engine::PORT_MAX_CHANNELS] = {};
+	};
+
+	rack::dsp::ClockDivider controlDivider;
+	bool controlDue = true;
+
+	std::vector<bool> isControlParam;
+	std::vector<float> controlParams;
+	std::vector<int> controlParamIds;
+
+	std::vector<int> controlInputIndex;
+	std::vector<ControlInput> controlInputs;
+
+	void configControlParam(int paramId) {
+		if (!isControlParam[paramId]) {
+			isControlParam[paramId] = true;
+			controlParamIds.push_back(paramId);
+			controlParams[paramId] = params[paramId].getValue();
+		}
+	}
+
+	void configControlParams(int firstId, int count) {
+		for (int i = 0; i < count; i++) {
+			configControlParam(firstId + i);
+		}
+	}
+
+	void configControlInput(int inputId) {
+		if (controlInputIndex[inputId] < 0) {
+			ControlInput ci;
+			ci.id = inputId;
+			controlInputIndex[inputId] = controlInputs.size();
+			controlInputs.push_back(ci);
+		}
+	}
+
+	void setControlDivision(int division) {
+		controlDivider.setDivision(division);
+	}
+
+	// Called from latchControls() for each control param that has moved since the last latch, so modules
+	// can recompute only what depends on it instead of comparing copies of their params every sample
+	virtual void onControlParamChange(int paramId) { }
+
+	void latchControls() {
+		for (int id : controlParamIds) {
+			float value = params[id].getValue();
+			if (value != controlParams[id]) {
+				controlParams[id] = value;
+				onControlParamChange(id);
+			}
+		}
+		for (ControlInput &ci : controlInputs) {
+			rack::engine::Input &in = inputs[ci.id];
+			ci.channels = in.getChannels();
+			for (int c = 0; c < std::max(ci.channels, 1); c++) { // Channel 0 of an unconnected input reads as 0V
+				ci.voltages[c] = in.getVoltage(c);
+			}
+		}
+		controlDue = true;
+	}
+
+	inline float getControlParam(int paramId) {
+		return isControlParam[paramId] ? controlParams[paramId] : params[paramId].getValue();
+	}
+
+	inline float getControlInput(int inputId, int channel = 0) {
+		int i = controlInputIndex[inputId];
+		return i < 0 ? inputs[inputId].getVoltage(channel) : controlInputs[i].voltages[channel];
+	}
+
+	inline int getControlChannels(int inputId) {
+		int i = controlInputIndex[inputId];
+		return i < 0 ? inputs[inputId].getChannels() : controlInputs[i].channels;
+	}
+
+	inline bool isControlConnected(int inputId) {
+		return getControlChannels(inputId) > 0;
+	}
+
+	virtual ~AHModule() {
+#ifndef METAMODULE
+		if (traceRing) {
+			TraceWriter::instance().remove(traceRing);
+			delete traceRing;
+		}
+#endif
 	}
 
 	int stepX = 0;
 
-	bool debugFlag = false;
+	// Tracing. trace() copies a fixed-size record into a lock-free ring that the TraceWriter drains from its
+	// own thread. The ring is created the first time tracing is switched on and kept until the module is
+	// deleted, so the audio thread never sees it go away. Modules name their event codes with setTraceNames().
+	// debugFlag is published with release after traceRing is set, so an acquire load that sees it true also
+	// sees the ring
+	std::atomic<bool> debugFlag{false};
+
+	TraceRing *traceRing = NULL;
+	const char *const *traceNames = NULL;
+	int nTraceNames = 0;
+
+	void setTraceNames(const char *const *names, int n) {
+		traceNames = names;
+		nTraceNames = n;
+	}
+
+	void setTracing(bool enabled) {
+#ifndef METAMODULE
+		if (enabled && !traceRing) {
+			traceRing = new TraceRing;
+		}
+		if (traceRing) {
+			if (enabled) {
+				TraceWriter::instance().add(traceRing, id, model ? model->slug : "", traceNames, nTraceNames);
+			} else {
+				TraceWriter::instance().remove(traceRing);
+			}
+		}
+		debugFlag.store(enabled, std::memory_order_release);
+#endif
+	}
+
+	inline void traceValues(int event, int n, float v0, float v1, float v2, float v3) {
+#ifndef METAMODULE
+		if (debugFlag.load(std::memory_order_acquire)) {
+			TraceRecord r;
+			r.stepX = stepX;
+			r.event = event;
+			r.nValues = n;
+			r.values[0] = v0;
+			r.values[1] = v1;
+			r.values[2] = v2;
+			r.values[3] = v3;
+			traceRing->push(r);
+		}
+#endif
+	}
+
+	inline void trace(int event) {
+		traceValues(event, 0, 0.0f, 0.0f, 0.0f, 0.0f);
+	}
+
+	inline void trace(int event, float v0) {
+		traceValues(event, 1, v0, 0.0f, 0.0f, 0.0f);
+	}
+
+	inline void trace(int event, float v0, float v1) {
+		traceValues(event, 2, v0, v1, 0.0f, 0.0f);
+	}
+
+	inline void trace(int event, float v0, float v1, float v2) {
+		traceValues(event, 3, v0, v1, v2, 0.0f);
+	}
+
+	inline void trace(int event, float v0, float v1, float v2, float v3) {
+		traceValues(event, 4, v0, v1, v2, v3);
+	}
 
 	inline bool debugEnabled() {
-		return debugFlag;
+		return debugFlag.load(std::memory_order_relaxed);
 	}
 
 	inline bool debugEnabled(int poll) {
-		if (debugFlag && stepX % poll == 0) {
+		if (debugFlag.load(std::memory_order_relaxed) && stepX % poll == 0) {
 			return true;
 		} else {
 			return false;
@@ -44,23 +419,61 @@ struct AHModule : rack::Module {
 
 	bool receiveEvents = false;
 	int keepStateDisplay = 0;
-	std::string paramState = ">";
+	ParamState paramState = {};
+	DisplaySnapshot<ParamState> paramDisplay;
 
 	virtual void receiveEvent(ParamEvent e) {
-		paramState = ">";
 		keepStateDisplay = 0;
 	}
 
+	// Shows the state the last param event left behind. Called on the UI thread with a copy published by the audio
+	// thread, so only the copy should be read here
+	virtual std::string formatParamState(const ParamState &state) {
+		return ">";
+	}
+
+	// Param events from the UI are queued and handed to receiveEvent() on the audio thread at the start of the next step
+	static const int EVENT_QUEUE_SIZE = 64;
+
+	EventQueue<ParamEvent, EVENT_QUEUE_SIZE> eventQueue;
+	uint32_t reportedOverflows = 0;
+
+	bool postEvent(ParamEvent e) {
+		return eventQueue.push(e);
+	}
+
+	void drainEvents() {
+		ParamEvent e;
+		while (eventQueue.pop(e)) {
+			receiveEvent(e);
+		}
+
+		uint32_t overflows = eventQueue.overflows.load(std::memory_order_relaxed);
+		if (overflows != reportedOverflows) {
+			trace(TRACE_DROPPED_EVENTS, (float)(overflows - reportedOverflows));
+			reportedOverflows = overflows;
+		}
+	}
+
 	void step() override {
 
 		stepX++;
 
+		lightsDue = lightDivider.process();
+
+		controlDue = false;
+		if (controlDivider.process() || stepX == 1) {
+			latchControls();
+		}
+
 		// Once we start stepping, we can process events
 		receiveEvents = true;
+		drainEvents();
 		// Timeout for display
 		keepStateDisplay++;
-		if (keepStateDisplay > 50000) {
-			paramState = ">"; 
+		if (keepStateDisplay > 50000 && paramState.keep) {
+			paramState.keep = 0;
+			paramDisplay.publish(paramState);
 		}
 
 	}
@@ -98,8 +511,11 @@ struct StateDisplay : TransparentWidget {
 
 			nvgFillColor(args.vg, nvgRGBA(0x00, 0xFF, 0xFF, 0xFF));
 
+			core::ParamState state = module->paramDisplay.read();
+			std::string paramText = state.keep ? module->formatParamState(state) : ">";
+
 			char text[128];
-			snprintf(text, sizeof(text), "%s", module->paramState.c_str());
+			snprintf(text, sizeof(text), "%s", paramText.c_str());
 			nvgText(args.vg, pos.x + 10, pos.y + 5, text, NULL);
 		}
 	}
@@ -138,7 +554,7 @@ struct AHKnob : RoundKnob, AHParamWidget {
 		if (!AHParamWidget::mod) {
 			AHParamWidget::mod = static_cast<core::AHModule *>(paramQuantity->module);
 		}
-		AHParamWidget::mod->receiveEvent(generateEvent(paramQuantity->getValue()));
+		AHParamWidget::mod->postEvent(generateEvent(paramQuantity->getValue()));
 		RoundKnob::onChange(e);
 	}
 };
@@ -215,6 +631,18 @@ struct ModeParamQuantity : engine::ParamQuantity {
 	std::string getDisplayValueString() override;
 };
 
+#ifndef METAMODULE
+
+// Context menu toggle for AHModule tracing
+struct TraceItem : MenuItem {
+	core::AHModule *module;
+	void onAction(const rack::widget::Widget::ActionEvent &e) override {
+		module->setTracing(!module->debugFlag);
+	}
+};
+
+#endif
+
 enum UIElement {
 	KNOB = 0,
 	PORT,
@@ -347,12 +775,119 @@ struct BpmCalculator {
 
 };
 
+// Decides when a pattern prepared ahead of time takes over from the one playing: on the next clock, when the current
+// cycle ends, or on the first clock of every Nth bar
+struct PatternSwitch {
+
+	enum Mode {
+		IMMEDIATE,
+		AT_EOC,
+		AT_BARS
+	};
+
+	const static int CLOCKS_PER_BAR = 4;
+
+	Mode mode = AT_EOC;
+	int bars = 1;
+	unsigned int clocks = 0;
+
+	// Call on every clock edge, true if a pending pattern should take over on this clock
+	bool clock() {
+		bool barStart = (clocks % (bars * CLOCKS_PER_BAR)) == 0;
+		clocks++;
+		switch (mode) {
+			case IMMEDIATE:	return true;
+			case AT_BARS:	return barStart;
+			default:		return false;
+		}
+	}
+
+	// True if a pending pattern should take over as the current cycle ends
+	bool atEndOfCycle() {
+		return mode != AT_BARS;
+	}
+
+	void reset() {
+		clocks = 0;
+	}
+
+};
+
+// Plays each arpeggiator step as one or more sub-steps, with swing on every other step. The clock interval is
+// measured in samples and the next one is assumed to match, so the sub-steps are laid out as countdowns when the
+// step is clocked rather than found by watching the clock
+struct StepScheduler {
+
+	int ratchets = 1;		// Sub-steps per step, 1-8
+	int swing = 50;			// Position of the off-beat in each pair of steps, 50% is straight
+
+	uint32_t sinceClock = 0;
+	uint32_t period = 0;	// Last clock interval, 0 until two clocks have been seen
+	bool offBeat = false;
+
+	int remaining = 0;
+	uint32_t countdown = 0;
+	uint32_t interval = 0;
+
+	// Call on every clock edge to track the tempo
+	void clock() {
+		if (sinceClock > 0) {
+			period = sinceClock;
+		}
+		sinceClock = 0;
+	}
+
+	// Call when a step has been clocked, replaces whatever is left of the previous step
+	void schedule() {
+		uint32_t delay = 0;
+		if (offBeat && swing > 50) {
+			delay = (period * (swing - 50)) / 50;
+		}
+		offBeat = !offBeat;
+
+		countdown = delay;
+		if (ratchets > 1 && period > 0) {
+			remaining = ratchets;
+			interval = std::max((period - delay) / ratchets, (uint32_t)1);
+		} else {
+			remaining = 1;
+			interval = 0;
+		}
+	}
+
+	// Call once per sample after any schedule(), true on the samples where a sub-step starts
+	bool process() {
+		sinceClock++;
+		if (remaining == 0) {
+			return false;
+		}
+		if (countdown > 0) {
+			countdown--;
+			return false;
+		}
+		remaining--;
+		countdown = interval > 0 ? interval - 1 : 0;
+		return true;
+	}
+
+	// Call when a step is clocked but plays nothing
+	void rest() {
+		offBeat = !offBeat;
+		remaining = 0;
+	}
+
+	void reset() {
+		offBeat = false;
+		remaining = 0;
+		countdown = 0;
+	}
+
+};
+
 } // namespace digital
 
 namespace music {
 
-const static int NUM_CHORDS = 99; // FIXME Remove this
-
 static constexpr float SEMITONE = 1.0 / 12.0;
 
 struct Chord {
@@ -379,16 +914,6 @@ struct Chord {
 
 };
 
-struct ChordDef {
-	int number;
-	std::string name;
-	int	root[6];
-	int	first[6];
-	int	second[6];
-};
-
-extern ChordDef ChordTable[NUM_CHORDS];
-
 struct ChordFormula {
 	std::string name;
 	std::vector<int> root;
@@ -595,6 +1120,39 @@ struct KnownChords {
 
 extern InversionDefinition defaultChord;
 
+// Voice leading. Tries each rotation of the new chord's notes across the voices, which takes in every inversion, and
+// moves each voice by whole octaves to where it is closest to the same voice of the previous chord. The rotation that
+// moves the voices least in total is kept. Optionally every voice is kept between low and high. A chord always costs
+// the same six rotations of six voices on the clock edge
+struct VoiceLeader {
+
+	enum Mode {
+		OFF,
+		CLOSEST,
+		CLOSEST_IN_RANGE
+	};
+
+	static const int NUM_VOICES = 6;
+
+	Mode mode = OFF;
+	float low = -1.0f;
+	float high = 1.0f;
+
+	float previous[NUM_VOICES];
+	bool havePrevious = false;
+
+	void reset() {
+		havePrevious = false;
+	}
+
+	void follow(const float *volts);
+	void lead(const float *volts, float *out);
+
+	private:
+		float place(const float *volts, int rotation, float *out);
+
+};
+
 } // namespace music
 
 } // namespace ah
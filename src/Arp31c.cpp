@@ -5,24 +5,38 @@
 
 struct Arpeggio2 {
 
-	std::vector<unsigned int> indexes;
+	// Longest pattern is Crab-RL/LR over 16 pitches with repeated ends, 55 steps
+	const static int MAX_INDEXES = 64;
+
+	typedef ah::core::FixedVector<unsigned int, MAX_INDEXES> IndexList;
+
+	// Current pattern, a row of the shared ArpPatternTable until it is randomized, then our own copy
+	const unsigned int *indexes = NULL;
+	IndexList shuffled;
 	unsigned int index = 0;
 	unsigned int offset = 0;	
 	unsigned int nPitches = 0;
 	bool repeatEnds = false;
 
 	Arpeggio2() {
-		indexes.push_back(0);
+		shuffled.push_back(0);
+		indexes = shuffled.items;
 		nPitches = 1;
 	}
 
 	virtual const std::string & getName() = 0;
 
-	virtual void initialise(unsigned int _nPitches, unsigned int _offset, bool _repeatEnds) {
-		nPitches = _nPitches;
-		offset = _offset;
+	// Build the pattern for a number of pitches. Only used to fill the ArpPatternTable
+	virtual void generate(unsigned int nPitches, bool repeatEnds, IndexList &indexes) = 0;
+
+	// Start a cycle on a precomputed pattern
+	void initialise(const IndexList &pattern, unsigned int _offset, bool _repeatEnds) {
+		indexes = pattern.items;
+		nPitches = pattern.size();
+		offset = _offset % nPitches;
+		index = offset;
 		repeatEnds = _repeatEnds;
-	};
+	}
 	
 	void advance() {
 		// std::cout << "ADV" << std::endl;
@@ -47,9 +61,18 @@ struct Arpeggio2 {
 
 		// std::cout << "RND " << length << " " << p1 << " " << p2 << " "; 
 
-		int t = indexes[p1];
-		indexes[p1] = indexes[p2];
-		indexes[p2] = t;
+		// Never write to the shared table, take a copy of the pattern first
+		if (indexes != shuffled.items) {
+			shuffled.clear();
+			for (unsigned int i = 0; i < nPitches; i++) {
+				shuffled.push_back(indexes[i]);
+			}
+			indexes = shuffled.items;
+		}
+
+		int t = shuffled[p1];
+		shuffled[p1] = shuffled[p2];
+		shuffled[p2] = t;
 
 		// for (int i = 0; i < nPitches; i++) {
 		// 	std::cout << indexes[i];
@@ -93,9 +116,7 @@ struct RightArp2 : Arpeggio2 {
 		return name;
 	};
 
-	void initialise(unsigned int _np, unsigned int _offset, bool _repeatEnds) override {
-
-		Arpeggio2::initialise(_np, _offset, _repeatEnds);
+	void generate(unsigned int nPitches, bool repeatEnds, IndexList &indexes) override {
 
 		// std::cout << name;
 		// std::cout << " DEF ";
@@ -106,10 +127,7 @@ struct RightArp2 : Arpeggio2 {
 			indexes.push_back(i);
 		}
 
-		nPitches = indexes.size();
-		offset = offset % nPitches;
-		index = offset;
-		// std::cout << " NP=" << nPitches << " -> " << index << std::endl;
+		// std::cout << " NP=" << indexes.size() << std::endl;
 
 	}
 		
@@ -123,9 +141,7 @@ struct LeftArp2 : Arpeggio2 {
 		return name;
 	};
 	
-	void initialise(unsigned int _np, unsigned int _offset, bool _repeatEnds) override {
-
-		Arpeggio2::initialise(_np, _offset, _repeatEnds);
+	void generate(unsigned int nPitches, bool repeatEnds, IndexList &indexes) override {
 
 		// std::cout << name;
 		// std::cout << " DEF ";
@@ -136,10 +152,7 @@ struct LeftArp2 : Arpeggio2 {
 			indexes.push_back(i);
 		}
 
-		nPitches = indexes.size();
-		offset = offset % nPitches;
-		index = offset;
-		// std::cout << " NP=" << nPitches << " -> " << index << std::endl;
+		// std::cout << " NP=" << indexes.size() << std::endl;
 
 	}
 		
@@ -153,9 +166,8 @@ struct RightLeftArp2 : Arpeggio2 {
 		return name;
 	};
 
-	void initialise(unsigned int _np, unsigned int _offset, bool _repeatEnds) override {
+	void generate(unsigned int nPitches, bool repeatEnds, IndexList &indexes) override {
 
-		Arpeggio2::initialise(_np, _offset, _repeatEnds);
 		// std::cout << name;
 		// std::cout << " DEF ";
 		indexes.clear();
@@ -172,10 +184,7 @@ struct RightLeftArp2 : Arpeggio2 {
 			indexes.push_back(i);
 		}
 
-		nPitches = indexes.size();
-		offset = offset % nPitches;
-		index = offset;
-		// std::cout << " NP=" << nPitches << " -> " << index << std::endl;
+		// std::cout << " NP=" << indexes.size() << std::endl;
 
 	}
 		
@@ -189,9 +198,7 @@ struct LeftRightArp2 : Arpeggio2 {
 		return name;
 	};
 
-	void initialise(unsigned int _np, unsigned int _offset, bool _repeatEnds) override {
-
-		Arpeggio2::initialise(_np, _offset, _repeatEnds);
+	void generate(unsigned int nPitches, bool repeatEnds, IndexList &indexes) override {
 
 		// std::cout << name;
 		// std::cout << " DEF ";
@@ -209,10 +216,7 @@ struct LeftRightArp2 : Arpeggio2 {
 			indexes.push_back(i);
 		}
 
-		nPitches = indexes.size();
-		offset = offset % nPitches;
-		index = offset;
-		// std::cout << " NP=" << nPitches << " -> " << index << std::endl;
+		// std::cout << " NP=" << indexes.size() << std::endl;
 
 	}
 		
@@ -226,9 +230,7 @@ struct CrabRightArp2 : Arpeggio2 {
 		return name;
 	};
 
-	void initialise(unsigned int _np, unsigned int _offset, bool _repeatEnds) override {
-
-		Arpeggio2::initialise(_np, _offset, _repeatEnds);
+	void generate(unsigned int nPitches, bool repeatEnds, IndexList &indexes) override {
 
 		// std::cout << name;
 		// std::cout << " DEF ";
@@ -265,10 +267,7 @@ struct CrabRightArp2 : Arpeggio2 {
 			} 
 		}
 
-		nPitches = indexes.size();
-		offset = offset % nPitches;
-		index = offset;
-		// std::cout << " NP=" << nPitches << " -> " << index << std::endl;
+		// std::cout << " NP=" << indexes.size() << std::endl;
 
 	}
 		
@@ -282,9 +281,7 @@ struct CrabLeftArp2 : Arpeggio2 {
 		return name;
 	};
 
-	void initialise(unsigned int _np, unsigned int _offset, bool _repeatEnds) override {
-
-		Arpeggio2::initialise(_np, _offset, _repeatEnds);
+	void generate(unsigned int nPitches, bool repeatEnds, IndexList &indexes) override {
 
 		// std::cout << name;
 		// std::cout << " DEF ";
@@ -321,10 +318,7 @@ struct CrabLeftArp2 : Arpeggio2 {
 			} 
 		}
 
-		nPitches = indexes.size();
-		offset = offset % nPitches;
-		index = offset;
-		// std::cout << " NP=" << nPitches << " -> " << index << std::endl;
+		// std::cout << " NP=" << indexes.size() << std::endl;
 
 	}
 		
@@ -338,9 +332,7 @@ struct CrabRightLeftArp2 : Arpeggio2 {
 		return name;
 	};
 
-	void initialise(unsigned int _np, unsigned int _offset, bool _repeatEnds) override {
-
-		Arpeggio2::initialise(_np, _offset, _repeatEnds);
+	void generate(unsigned int nPitches, bool repeatEnds, IndexList &indexes) override {
 
 		// std::cout << name;
 		// std::cout << " DEF ";
@@ -398,10 +390,7 @@ struct CrabRightLeftArp2 : Arpeggio2 {
 			} 
 		}
 
-		nPitches = indexes.size();
-		offset = offset % nPitches;
-		index = offset;
-		// std::cout << " NP=" << nPitches << " -> " << index << std::endl;
+		// std::cout << " NP=" << indexes.size() << std::endl;
 
 	}
 		
@@ -415,9 +404,7 @@ struct CrabLeftRightArp2 : Arpeggio2 {
 		return name;
 	};
 
-	void initialise(unsigned int _np, unsigned int _offset, bool _repeatEnds) override {
-
-		Arpeggio2::initialise(_np, _offset, _repeatEnds);
+	void generate(unsigned int nPitches, bool repeatEnds, IndexList &indexes) override {
 
 		// std::cout << name;
 		// std::cout << " DEF ";
@@ -475,17 +462,157 @@ struct CrabLeftRightArp2 : Arpeggio2 {
 			} 
 		}
 
-		nPitches = indexes.size();
-		offset = offset % nPitches;
-		index = offset;
-		// std::cout << " NP=" << nPitches << " -> " << index << std::endl;
+		// std::cout << " NP=" << indexes.size() << std::endl;
 
 	}
 		
 };
 
+// Every pattern for each arp type, number of pitches and repeat-ends setting, built once when the first module is
+// created. Starting a cycle only points the arp at a row of the table, and the display previews from it
+struct ArpPatternTable {
+
+	const static int NUM_ARPS = 8;
+	const static int MAX_PITCHES = 16;
+
+	Arpeggio2::IndexList patterns[NUM_ARPS][MAX_PITCHES][2];
+
+	ArpPatternTable() {
+
+		RightArp2 			arp_right;
+		LeftArp2 			arp_left;
+		RightLeftArp2 		arp_rightleft;
+		LeftRightArp2 		arp_leftright;
+		CrabRightArp2 		arp_crabright;
+		CrabLeftArp2 		arp_crableft;
+		CrabRightLeftArp2	arp_crabrightleft;
+		CrabLeftRightArp2	arp_crableftright;
+
+		Arpeggio2 *arps[NUM_ARPS] = {&arp_right, &arp_left, &arp_rightleft, &arp_leftright, 
+			&arp_crabright, &arp_crableft, &arp_crabrightleft, &arp_crableftright};
+
+		Arpeggio2::IndexList raw;
+
+		for (int a = 0; a < NUM_ARPS; a++) {
+			for (unsigned int n = 1; n <= MAX_PITCHES; n++) {
+				for (int r = 0; r < 2; r++) {
+					arps[a]->generate(n, r, raw);
+
+					// The short crab patterns can step outside the chord, drop those steps
+					Arpeggio2::IndexList &pattern = patterns[a][n - 1][r];
+					pattern.clear();
+					for (unsigned int idx : raw) {
+						if (idx < n) {
+							pattern.push_back(idx);
+						}
+					}
+					if (pattern.empty()) {
+						pattern.push_back(0);
+					}
+				}
+			}
+		}
+	}
+
+	const Arpeggio2::IndexList &get(unsigned int arp, unsigned int nPitches, bool repeatEnds) {
+		arp = std::min(arp, (unsigned int)(NUM_ARPS - 1));
+		nPitches = std::max(1u, std::min(nPitches, (unsigned int)MAX_PITCHES));
+		return patterns[arp][nPitches - 1][repeatEnds ? 1 : 0];
+	}
+
+	static ArpPatternTable &instance() {
+		static ArpPatternTable table;
+		return table;
+	}
+
+};
+
+// Independent arpeggiators driven by the channels of a poly clock, stored as structure-of-arrays so that a sample
+// where no clock channel fired only touches the pulse generators
+struct Arp31Lanes {
+
+	const static int MAX_LANES = 16;
+
+	int nLanes = 0;
+
+	rack::dsp::SchmittTrigger clockTrigger[MAX_LANES];
+	rack::dsp::PulseGenerator gatePulse[MAX_LANES];
+	rack::dsp::PulseGenerator eocPulse[MAX_LANES];
+
+	const unsigned int *indexes[MAX_LANES];
+	unsigned int length[MAX_LANES];
+	unsigned int index[MAX_LANES];
+	unsigned int offset[MAX_LANES];
+	unsigned int arp[MAX_LANES];
+	bool running[MAX_LANES];
+	bool eoc[MAX_LANES];
+	float outVolts[MAX_LANES];
+
+	ah::core::FixedVector<float, rack::engine::PORT_MAX_CHANNELS> pitches[MAX_LANES];
+	Arpeggio2::IndexList shuffled[MAX_LANES];
+
+	Arp31Lanes() {
+		for (int l = 0; l < MAX_LANES; l++) {
+			shuffled[l].push_back(0);
+			indexes[l] = shuffled[l].items;
+			length[l] = 1;
+			index[l] = 0;
+			offset[l] = 0;
+			arp[l] = 0;
+			running[l] = false;
+			eoc[l] = false;
+			outVolts[l] = 0.0f;
+			pitches[l].push_back(0.0f);
+		}
+	}
+
+	void initialise(int l, const Arpeggio2::IndexList &pattern, unsigned int _offset) {
+		indexes[l] = pattern.items;
+		length[l] = pattern.size();
+		offset[l] = _offset % length[l];
+		index[l] = offset[l];
+	}
+
+	// Same swap as Arpeggio2::randomize, on the lane's own copy of the pattern
+	void randomize(int l) {
+		int n = length[l] - offset[l];
+		int p1 = (rand() % n) + offset[l];
+		int p2 = (rand() % n) + offset[l];
+		int tries = 0;
+
+		while (p1 == p2 && tries < 5) {
+			p2 = (rand() % n) + offset[l];
+			tries++;
+		}
+
+		if (indexes[l] != shuffled[l].items) {
+			shuffled[l].clear();
+			for (unsigned int i = 0; i < length[l]; i++) {
+				shuffled[l].push_back(indexes[l][i]);
+			}
+			indexes[l] = shuffled[l].items;
+		}
+
+		unsigned int t = shuffled[l][p1];
+		shuffled[l][p1] = shuffled[l][p2];
+		shuffled[l][p2] = t;
+	}
+
+};
+
 using namespace ah;
 
+static const char *const ARP31_TRACE_NAMES[] = {
+	"EOC fired",
+	"Advance cycle: index, V",
+	"Finished cycle",
+	"Step: index, V, light",
+	"No inputs, assume single 0V pitch",
+	"New cycle: arpeggio, pitches",
+	"Hold cycle: arpeggio, pitches",
+	"Pitch channels"
+};
+
 struct Arp31 : core::AHModule {
 	
 	const static int MAX_STEPS = 16;
@@ -503,6 +630,8 @@ struct Arp31 : core::AHModule {
 		ARP_INPUT,
 		HOLD_INPUT,
 		RANDOM_INPUT,
+		BANK_INPUT,
+		CAPTURE_INPUT,
 		NUM_INPUTS
 	};
 	enum OutputIds {
@@ -514,6 +643,18 @@ struct Arp31 : core::AHModule {
 	enum LightIds {
 		NUM_LIGHTS
 	};
+
+	enum TraceIds {
+		TRACE_EOC,
+		TRACE_ADVANCE,
+		TRACE_FINISHED,
+		TRACE_STEP,
+		TRACE_NO_PITCHES,
+		TRACE_NEW_CYCLE,
+		TRACE_HOLD_CYCLE,
+		TRACE_CHANNELS,
+		NUM_TRACES
+	};
 	
 	Arp31() : core::AHModule(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS) {
 		configParam(OFFSET_PARAM, 0.0, 10.0, 0.0, "Start offset");
@@ -527,6 +668,8 @@ struct Arp31 : core::AHModule {
 		configInput(ARP_INPUT, "Arpeggio selection");
 		configInput(HOLD_INPUT, "Trigger: Hold arpeggio");
 		configInput(RANDOM_INPUT, "Trigger: Randomize arpeggio pitch order");
+		configInput(BANK_INPUT, "Chord bank: below 1V input pitches, 1V-8V stored chords 1-8");
+		configInput(CAPTURE_INPUT, "Trigger: Store input pitches in the selected chord bank");
 
 		configOutput(OUT_OUTPUT, "1V/oct pitch");
 		configOutput(GATE_OUTPUT, "Trigger: On pitch change");
@@ -540,17 +683,25 @@ struct Arp31 : core::AHModule {
 		arps.push_back(&arp_crableft);
 		arps.push_back(&arp_crabrightleft);
 		arps.push_back(&arp_crableftright);
-		nextArp = arps[0]->getName();
+		patterns = &ArpPatternTable::instance();
 
 		onReset();
-		id = rand();
-        debugFlag = false;
+		setTraceNames(ARP31_TRACE_NAMES, NUM_TRACES);
 	}
 
 	void process(const ProcessArgs &args) override;
+	void readChord(core::FixedVector<float, engine::PORT_MAX_CHANNELS> &chord);
+	void processLanes(const ProcessArgs &args, size_t offset, int hold, bool randomStatus);
+	void readLanePitches(int l);
 	
 	void onReset() override {
 		isRunning = false;
+		patternSwitch.reset();
+		scheduler.reset();
+		for (int l = 0; l < Arp31Lanes::MAX_LANES; l++) {
+			lanes.running[l] = false;
+			lanes.eoc[l] = false;
+		}
 	}
 	
 	json_t *dataToJson() override {
@@ -564,6 +715,45 @@ struct Arp31 : core::AHModule {
 		json_t *repeatModeJ = json_boolean((bool) repeatEnd);
 		json_object_set_new(rootJ, "repeatMode", repeatModeJ);
 
+		// switchMode
+		json_t *switchModeJ = json_integer((int) patternSwitch.mode);
+		json_object_set_new(rootJ, "switchMode", switchModeJ);
+
+		// switchBars
+		json_t *switchBarsJ = json_integer(patternSwitch.bars);
+		json_object_set_new(rootJ, "switchBars", switchBarsJ);
+
+		// bank
+		json_t *bankJ = json_integer(selectedBank);
+		json_object_set_new(rootJ, "bank", bankJ);
+
+		// banks
+		json_t *banksJ = json_array();
+		for (int b = 0; b < NUM_BANKS; b++) {
+			json_t *chordJ = json_array();
+			for (size_t i = 0; i < banks[b].size(); i++) {
+				json_array_append_new(chordJ, json_real(banks[b][i]));
+			}
+			json_array_append_new(banksJ, chordJ);
+		}
+		json_object_set_new(rootJ, "banks", banksJ);
+
+		// polyClock
+		json_t *polyClockJ = json_boolean(polyClock);
+		json_object_set_new(rootJ, "polyClock", polyClockJ);
+
+		// splitChord
+		json_t *splitChordJ = json_boolean(splitChord);
+		json_object_set_new(rootJ, "splitChord", splitChordJ);
+
+		// ratchets
+		json_t *ratchetsJ = json_integer(scheduler.ratchets);
+		json_object_set_new(rootJ, "ratchets", ratchetsJ);
+
+		// swing
+		json_t *swingJ = json_integer(scheduler.swing);
+		json_object_set_new(rootJ, "swing", swingJ);
+
 		return rootJ;
 	}
 	
@@ -576,6 +766,48 @@ struct Arp31 : core::AHModule {
 		json_t *repeatModeJ = json_object_get(rootJ, "repeatMode");
 		if (repeatModeJ) repeatEnd = json_boolean_value(repeatModeJ);
 
+		// switchMode
+		json_t *switchModeJ = json_object_get(rootJ, "switchMode");
+		if (switchModeJ) patternSwitch.mode = (digital::PatternSwitch::Mode)json_integer_value(switchModeJ);
+
+		// switchBars
+		json_t *switchBarsJ = json_object_get(rootJ, "switchBars");
+		if (switchBarsJ) patternSwitch.bars = std::max((int)json_integer_value(switchBarsJ), 1);
+
+		// bank
+		json_t *bankJ = json_object_get(rootJ, "bank");
+		if (bankJ) selectedBank = clamp((int)json_integer_value(bankJ), -1, NUM_BANKS - 1);
+
+		// banks
+		json_t *banksJ = json_object_get(rootJ, "banks");
+		if (banksJ) {
+			for (int b = 0; b < NUM_BANKS; b++) {
+				banks[b].clear();
+				json_t *chordJ = json_array_get(banksJ, b);
+				if (chordJ) {
+					for (size_t i = 0; i < json_array_size(chordJ); i++) {
+						banks[b].push_back(json_number_value(json_array_get(chordJ, i)));
+					}
+				}
+			}
+		}
+
+		// polyClock
+		json_t *polyClockJ = json_object_get(rootJ, "polyClock");
+		if (polyClockJ) polyClock = json_boolean_value(polyClockJ);
+
+		// splitChord
+		json_t *splitChordJ = json_object_get(rootJ, "splitChord");
+		if (splitChordJ) splitChord = json_boolean_value(splitChordJ);
+
+		// ratchets
+		json_t *ratchetsJ = json_object_get(rootJ, "ratchets");
+		if (ratchetsJ) scheduler.ratchets = clamp((int)json_integer_value(ratchetsJ), 1, 8);
+
+		// swing
+		json_t *swingJ = json_object_get(rootJ, "swing");
+		if (swingJ) scheduler.swing = clamp((int)json_integer_value(swingJ), 50, 75);
+
 	}
 	
 	enum GateMode {
@@ -591,14 +823,27 @@ struct Arp31 : core::AHModule {
 	rack::dsp::PulseGenerator gatePulse;
 	rack::dsp::PulseGenerator eocPulse;
 
-	int id = 0;
 	int currLight = 0;
 	float outVolts = 0;
+	float stepVolts = 0;
 	bool isRunning = false;
 	unsigned int inputArp = 0;
 	bool eoc = false;
 	bool repeatEnd = false;
 
+	// Stored chords, played in place of the input pitches while one is selected. -1 selects the inputs
+	const static int NUM_BANKS = 8;
+	core::FixedVector<float, engine::PORT_MAX_CHANNELS> banks[NUM_BANKS];
+	int selectedBank = -1;
+	int activeBank = -1;
+	int captureNext = 0;
+	rack::dsp::SchmittTrigger captureTrigger;
+
+	// Run one lane per clock channel, optionally giving each lane its own slice of the chord
+	bool polyClock = false;
+	bool splitChord = false;
+	Arp31Lanes lanes;
+
 	std::vector<Arpeggio2 *> arps;
 
 	RightArp2 			arp_right;
@@ -611,9 +856,40 @@ struct Arp31 : core::AHModule {
 	CrabLeftRightArp2	arp_crableftright;
 
 	Arpeggio2 *currArp = &arp_right;
+
+	ArpPatternTable *patterns = NULL;
+	unsigned int cyclePitches = 1;
+
+	// The pattern playing, a changed one takes over according to the switch mode. Every pattern is already in the
+	// table, so switching only moves the arp onto another row
+	unsigned int playingArp = 0;
+	size_t playingOffset = 0;
+	bool playingRepeat = false;
+	digital::PatternSwitch patternSwitch;
+	digital::StepScheduler scheduler;
+
+	void startPattern(unsigned int arp, size_t offset) {
+		currArp = arps[arp];
+		currArp->initialise(patterns->get(arp, cyclePitches, repeatEnd), offset, repeatEnd);
+		playingArp = arp;
+		playingOffset = offset;
+		playingRepeat = repeatEnd;
+	}
+
+	// State shown on the panel, published for the widget
+	struct DisplayState {
+		int arp;
+		int nPitches;
+		int offset;
+		int repeatEnd;
+		int bank;
+		int index;
+		float pitch;
+	};
+
+	core::DisplaySnapshot<DisplayState> display;
 	
-	std::vector<float> pitches;
-	std::string nextArp;
+	core::FixedVector<float, engine::PORT_MAX_CHANNELS> pitches;
 
 };
 
@@ -640,9 +916,32 @@ void Arp31::process(const ProcessArgs &args) {
 	size_t offset = params[OFFSET_PARAM].getValue();
 	int hold = digital::sgn(inputs[HOLD_INPUT].getVoltage(), 0.001);
 
+	// Pick the chord bank, this is all it takes to switch between them
+	if (inputs[BANK_INPUT].isConnected()) {
+		int bank = static_cast<int>(inputs[BANK_INPUT].getVoltage());
+		activeBank = (bank < 1) ? -1 : std::min(bank, (int)NUM_BANKS) - 1;
+	} else {
+		activeBank = selectedBank;
+	}
+
+	// Store the input pitches, into the next bank in turn if we are playing the inputs
+	if (captureTrigger.process(inputs[CAPTURE_INPUT].getVoltage())) {
+		int bank = activeBank;
+		if (bank < 0) {
+			bank = captureNext;
+			captureNext = (captureNext + 1) % NUM_BANKS;
+		}
+		readChord(banks[bank]);
+	}
+
 	// Process inputs
 	bool clockStatus = clockTrigger.process(clockInput);
 	bool randomStatus = randomTrigger.process(randomInput);
+
+	if (polyClock) {
+		processLanes(args, offset, hold, randomStatus);
+		return;
+	}
 	
 	// If there is no clock input, then force that we are not running
 	if (!clockActive) {
@@ -650,29 +949,18 @@ void Arp31::process(const ProcessArgs &args) {
 	}
 
 	bool restart = false;
-
-	#ifndef METAMODULE
-	#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " " << id  << " Check clock" << std::endl; }
-#endif
-	#endif
+	bool pending = (inputArp != playingArp || offset != playingOffset || repeatEnd != playingRepeat);
 
 	// Have we been clocked?
 	if (clockStatus) {
 
-		#ifndef METAMODULE
-		#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " " << id  << " Check EOC" << std::endl; }
-#endif
-		#endif
+		scheduler.clock();
+
+		bool switchNow = patternSwitch.clock();
 
 		// EOC was fired at last sequence step
 		if (eoc) {
-			#ifndef METAMODULE
-			#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " " << id  << " EOC fired" << std::endl; }
-#endif
-			#endif
+			trace(TRACE_EOC);
 			eocPulse.trigger(digital::TRIGGER);
 			eoc = false;
 		}	
@@ -680,11 +968,12 @@ if (debugEnabled()) { std::cout << stepX << " " << id  << " EOC fired" << std::e
 		// If we are already running, process cycle
 		if (isRunning) {
 
-			#ifndef METAMODULE
-			#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " " << id  << " Advance Cycle: " << currArp->getPitch() << " " << pitches[currArp->getPitch()] << std::endl; }
-#endif
-			#endif
+			// Take up a changed pattern straight away or at the bar, from its start
+			if (switchNow && pending && !hold) {
+				startPattern(inputArp, offset);
+			}
+
+			trace(TRACE_ADVANCE, currArp->getPitch(), pitches[currArp->getPitch()]);
 
 			// Reached the end of the pattern?
 			if (currArp->isArpeggioFinished()) {
@@ -692,27 +981,19 @@ if (debugEnabled()) { std::cout << stepX << " " << id  << " Advance Cycle: " <<
 				// Trigger EOC mechanism
 				eoc = true;
 
-				#ifndef METAMODULE
-				#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " " << id  << " Finished Cycle" << std::endl; }
-#endif
-				#endif
+				trace(TRACE_FINISHED);
 				restart = true;
 
 			} 
 
 			// Finally set the out voltage
 			size_t idx = currArp->getPitch();
-			outVolts = clamp(pitches[idx], -10.0f, 10.0f);
+			stepVolts = clamp(pitches[idx], -10.0f, 10.0f);
 
-			#ifndef METAMODULE
-			#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " " << id  << " Index: " << idx << " V: " << outVolts << " Light: " << currLight << std::endl; }
-#endif
-			#endif
+			trace(TRACE_STEP, idx, stepVolts, currLight);
 
-			// Pulse the output gate
-			gatePulse.trigger(digital::TRIGGER);
+			// Pulse the output gate, or start the ratchets
+			scheduler.schedule();
 
 			// Completed 1 step
 			currArp->advance();
@@ -731,84 +1012,42 @@ if (debugEnabled()) { std::cout << stepX << " " << id  << " Index: " << idx << "
 		currArp->randomize();
 	}
 
-	#ifndef METAMODULE
-	#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " " << id  << " Check restart" << std::endl; }
-#endif
-	#endif
-
 	// If we have been triggered, start a new sequence
 	if (restart) {
 
 		if (!hold) {
 
-			// Read input pitches and assign to pitch array
-			pitches.clear();
-			if (inputs[PITCH_INPUT].isConnected()) {
-				int channels = inputs[PITCH_INPUT].getChannels();
-				#ifndef METAMODULE	
-				#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " " << id  << " Channels: " << channels << std::endl; }
-#endif
-				#endif
-
-				if (inputs[GATE_INPUT].isConnected()) {
-					for (int p = 0; p < channels; p++) {
-						if (inputs[GATE_INPUT].getVoltage(p) > 0.0f) {
-							pitches.push_back(inputs[PITCH_INPUT].getVoltage(p));
-						}
-					}
-				} else { // No gate info, read sequentially;
-					for (int p = 0; p < channels; p++) {
-						pitches.push_back(inputs[PITCH_INPUT].getVoltage(p));
-					}
-				}
-
-			} 
+			// Play the selected chord bank, otherwise read input pitches and assign to pitch array
+			if (activeBank >= 0 && !banks[activeBank].empty()) {
+				pitches = banks[activeBank];
+			} else {
+				readChord(pitches);
+			}
 
 			if (pitches.size() == 0) {
-				#ifndef METAMODULE
-				#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " " << id  << " No inputs, assume single 0V pitch" << std::endl; }
-#endif
-				#endif
+				trace(TRACE_NO_PITCHES);
 				pitches.push_back(0.0f);
 			}
 
-			#ifndef METAMODULE
-			#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " " << id  << " Pitches: " << pitches.size() << std::endl; }
-#endif
-			#endif
-
 			// At the first step of the cycle
-			// So this is where we tweak the cycle parameters
-			currArp = arps[inputArp];
+			// So this is where we tweak the cycle parameters, unless a changed pattern is waiting for the bar
+			cyclePitches = pitches.size();
+			if (!isRunning || !pending || patternSwitch.atEndOfCycle()) {
+				startPattern(inputArp, offset);
+			} else {
+				startPattern(playingArp, playingOffset);
+			}
 
-			#ifndef METAMODULE
-			#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " " << id  << " Initiatise new Cycle: Pattern: " << currArp->getName() << " nPitches: " << pitches.size() << std::endl; }
-#endif
-			#endif
-			
-			currArp->initialise(pitches.size(), offset, repeatEnd);
+			trace(TRACE_NEW_CYCLE, playingArp, pitches.size());
 
 		} else {
 
 			if (pitches.size() == 0) {
-				#ifndef METAMODULE
-				#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " " << id  << " No inputs, assume single 0V pitch" << std::endl; }
-#endif
-				#endif
+				trace(TRACE_NO_PITCHES);
 				pitches.push_back(0.0f);
 			}
 
-			#ifndef METAMODULE
-			#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " " << id  << " Hold Cycle: Pattern: " << currArp->getName() << " nPitches: " << pitches.size() << std::endl; }
-#endif
-			#endif
+			trace(TRACE_HOLD_CYCLE, playingArp, pitches.size());
 
 			currArp->reset();
 
@@ -819,19 +1058,30 @@ if (debugEnabled()) { std::cout << stepX << " " << id  << " Hold Cycle: Pattern:
 		
 	} 
 
-	nextArp = arps[inputArp]->getName();
+	// Play the step, or its next ratchet
+	if (scheduler.process()) {
+		outVolts = stepVolts;
+		gatePulse.trigger(digital::TRIGGER);
+	}
+
+	DisplayState state;
+	state.arp = inputArp;
+	state.nPitches = cyclePitches;
+	state.offset = offset;
+	state.repeatEnd = repeatEnd;
+	state.bank = activeBank;
+	state.index = currArp->index;
+	state.pitch = outVolts;
+	display.publish(state);
 
 	// Set the value
+	outputs[OUT_OUTPUT].setChannels(1);
+	outputs[GATE_OUTPUT].setChannels(1);
+	outputs[EOC_OUTPUT].setChannels(1);
 	outputs[OUT_OUTPUT].setVoltage(outVolts);
 
 	bool gPulse = gatePulse.process(args.sampleTime);
 
-	#ifndef METAMODULE
-	#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " " << id  << " Do gate status" << std::endl; }
-#endif
-	#endif
-
 	bool gatesOn = isRunning;
 	if (gateMode == TRIGGER) {
 		gatesOn = gatesOn && gPulse;
@@ -839,25 +1089,197 @@ if (debugEnabled()) { std::cout << stepX << " " << id  << " Do gate status" << s
 		gatesOn = gatesOn && !gPulse;
 	}
 
-	#ifndef METAMODULE
-	#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " " << id  << " Checked gate status" << std::endl; }
-#endif
-	#endif
-
 	bool cPulse = eocPulse.process(args.sampleTime);
 
 	outputs[GATE_OUTPUT].setVoltage(gatesOn ? 10.0 : 0.0);
 	outputs[EOC_OUTPUT].setVoltage(cPulse ? 10.0 : 0.0);
 
-	#ifndef METAMODULE
-	#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " " << id  << " Finish output phase" << std::endl; }
-#endif
-	#endif
+}
+
+void Arp31::readChord(core::FixedVector<float, engine::PORT_MAX_CHANNELS> &chord) {
+
+	chord.clear();
+	if (inputs[PITCH_INPUT].isConnected()) {
+		int channels = inputs[PITCH_INPUT].getChannels();
+		trace(TRACE_CHANNELS, channels);
+
+		if (inputs[GATE_INPUT].isConnected()) {
+			for (int p = 0; p < channels; p++) {
+				if (inputs[GATE_INPUT].getVoltage(p) > 0.0f) {
+					chord.push_back(inputs[PITCH_INPUT].getVoltage(p));
+				}
+			}
+		} else { // No gate info, read sequentially;
+			for (int p = 0; p < channels; p++) {
+				chord.push_back(inputs[PITCH_INPUT].getVoltage(p));
+			}
+		}
+	}
+
+}
+
+void Arp31::readLanePitches(int l) {
+
+	core::FixedVector<float, engine::PORT_MAX_CHANNELS> &lanePitches = lanes.pitches[l];
+	lanePitches.clear();
+
+	// A stored chord stands in for the input pitches
+	const core::FixedVector<float, engine::PORT_MAX_CHANNELS> *bank = NULL;
+	if (activeBank >= 0 && !banks[activeBank].empty()) {
+		bank = &banks[activeBank];
+	}
+
+	if (bank || inputs[PITCH_INPUT].isConnected()) {
+		int channels = bank ? bank->size() : inputs[PITCH_INPUT].getChannels();
+		int first = 0;
+		int last = channels;
+
+		// Give each lane a contiguous slice of the chord, lanes beyond the number of notes wrap around
+		if (splitChord) {
+			int nLanes = lanes.nLanes;
+			if (nLanes > channels) {
+				first = l % channels;
+				last = first + 1;
+			} else {
+				first = (l * channels) / nLanes;
+				last = ((l + 1) * channels) / nLanes;
+			}
+		}
+
+		bool gated = !bank && inputs[GATE_INPUT].isConnected();
+		for (int p = first; p < last; p++) {
+			if (bank) {
+				lanePitches.push_back((*bank)[p]);
+			} else if (!gated || inputs[GATE_INPUT].getVoltage(p) > 0.0f) {
+				lanePitches.push_back(inputs[PITCH_INPUT].getVoltage(p));
+			}
+		}
+	}
+
+	if (lanePitches.empty()) {
+		lanePitches.push_back(0.0f);
+	}
 
 }
 
+void Arp31::processLanes(const ProcessArgs &args, size_t offset, int hold, bool randomStatus) {
+
+	int nLanes = std::max(inputs[CLOCK_INPUT].getChannels(), 1);
+
+	// Lanes that have dropped out start afresh when their clock channel returns
+	for (int l = nLanes; l < lanes.nLanes; l++) {
+		lanes.running[l] = false;
+		lanes.eoc[l] = false;
+	}
+	lanes.nLanes = nLanes;
+
+	bool clockActive = inputs[CLOCK_INPUT].isConnected();
+	int arpChannels = inputs[ARP_INPUT].getChannels();
+
+	for (int l = 0; l < nLanes; l++) {
+
+		if (!clockActive) {
+			lanes.running[l] = false;
+			continue;
+		}
+
+		if (!lanes.clockTrigger[l].process(inputs[CLOCK_INPUT].getVoltage(l))) {
+			continue;
+		}
+
+		bool restart = false;
+
+		if (lanes.eoc[l]) {
+			lanes.eocPulse[l].trigger(digital::TRIGGER);
+			lanes.eoc[l] = false;
+		}
+
+		if (lanes.running[l]) {
+
+			if (lanes.index[l] >= lanes.length[l] - 1) {
+				lanes.eoc[l] = true;
+				restart = true;
+			}
+
+			lanes.outVolts[l] = clamp(lanes.pitches[l][lanes.indexes[l][lanes.index[l]]], -10.0f, 10.0f);
+			lanes.gatePulse[l].trigger(digital::TRIGGER);
+			lanes.index[l]++;
+
+		} else {
+			restart = true;
+		}
+
+		if (restart) {
+
+			if (!hold) {
+
+				readLanePitches(l);
+
+				// A poly arp input selects the arp per lane, otherwise every lane follows the panel
+				if (arpChannels > 1) {
+					lanes.arp[l] = std::min(std::max(static_cast<int>(inputs[ARP_INPUT].getVoltage(l)), 0), 7);
+				} else {
+					lanes.arp[l] = inputArp;
+				}
+
+				// Stagger the start of each lane by the offset, so that one chord played over several lanes forms a canon
+				lanes.initialise(l, patterns->get(lanes.arp[l], lanes.pitches[l].size(), repeatEnd), offset * l);
+
+			} else {
+				lanes.index[l] = lanes.offset[l];
+			}
+
+			lanes.running[l] = true;
+
+		}
+
+	}
+
+	if (randomStatus && hold != -1) {
+		for (int l = 0; l < nLanes; l++) {
+			if (lanes.running[l]) {
+				lanes.randomize(l);
+			}
+		}
+	}
+
+	DisplayState state;
+	state.arp = lanes.arp[0];
+	state.nPitches = lanes.pitches[0].size();
+	state.offset = lanes.offset[0];
+	state.repeatEnd = repeatEnd;
+	state.bank = activeBank;
+	state.index = lanes.index[0];
+	state.pitch = lanes.outVolts[0];
+	display.publish(state);
+
+	outputs[OUT_OUTPUT].setChannels(nLanes);
+	outputs[GATE_OUTPUT].setChannels(nLanes);
+	outputs[EOC_OUTPUT].setChannels(nLanes);
+
+	for (int l = 0; l < nLanes; l++) {
+
+		bool gPulse = lanes.gatePulse[l].process(args.sampleTime);
+		bool cPulse = lanes.eocPulse[l].process(args.sampleTime);
+
+		bool gatesOn = lanes.running[l];
+		if (gateMode == TRIGGER) {
+			gatesOn = gatesOn && gPulse;
+		} else if (gateMode == RETRIGGER) {
+			gatesOn = gatesOn && !gPulse;
+		}
+
+		outputs[OUT_OUTPUT].setVoltage(lanes.outVolts[l], l);
+		outputs[GATE_OUTPUT].setVoltage(gatesOn ? 10.0 : 0.0, l);
+		outputs[EOC_OUTPUT].setVoltage(cPulse ? 10.0 : 0.0, l);
+
+	}
+
+}
+
+static const char *const ARP31_NAMES[ArpPatternTable::NUM_ARPS] = 
+	{"Straight-R", "Straight-L", "Straight-RL", "Straight-LR", "Crab-R", "Crab-L", "Crab-RL", "Crab-LR"};
+
 struct Arp31Display : TransparentWidget {
 	
 	Arp31 *module;
@@ -875,6 +1297,8 @@ struct Arp31Display : TransparentWidget {
 
 		Vec pos = Vec(3,12.5);
 
+		Arp31::DisplayState state = module->display.read();
+
 		std::shared_ptr<Font> font = APP->window->loadFont(fontPath);
 
 		if (font) {		
@@ -885,8 +1309,27 @@ struct Arp31Display : TransparentWidget {
 			nvgFillColor(ctx.vg, nvgRGBA(0x00, 0xFF, 0xFF, 0xFF));
 		
 			char text[128];
-			snprintf(text, sizeof(text), "%s", module->nextArp.c_str());
+			if (state.bank >= 0) {
+				snprintf(text, sizeof(text), "%s [%d]", ARP31_NAMES[state.arp], state.bank + 1);
+			} else {
+				snprintf(text, sizeof(text), "%s", ARP31_NAMES[state.arp]);
+			}
 			nvgText(ctx.vg, pos.x, pos.y, text, NULL);
+
+			// Preview the note order of the next cycle, straight from the pattern table. A cycle plays from the
+			// offset to the end of the pattern, it does not wrap round
+			const Arpeggio2::IndexList &pattern = ArpPatternTable::instance().get(state.arp, state.nPitches, state.repeatEnd);
+			unsigned int start = state.offset % pattern.size();
+
+			char preview[128];
+			size_t len = 0;
+			preview[0] = 0;
+			for (size_t i = start; i < pattern.size() && len < 24; i++) {
+				len += snprintf(preview + len, sizeof(preview) - len, "%d ", pattern[i] + 1);
+			}
+
+			nvgFontSize(ctx.vg, 11);
+			nvgText(ctx.vg, pos.x, pos.y + 14, preview, NULL);
 		}		
 	}
 	
@@ -911,6 +1354,8 @@ struct Arp31Widget : ModuleWidget {
 		addInput(createInputCentered<gui::AHPort>(Vec(68.403, 139.48), module, Arp31::GATE_INPUT));
 		addInput(createInputCentered<gui::AHPort>(Vec(36.028, 327.111), module, Arp31::PITCH_INPUT));
 		addInput(createInputCentered<gui::AHPort>(Vec(103.309, 327.111), module, Arp31::CLOCK_INPUT));
+		addInput(createInputCentered<gui::AHPort>(Vec(30.5, 278.811), module, Arp31::BANK_INPUT));
+		addInput(createInputCentered<gui::AHPort>(Vec(104.5, 278.811), module, Arp31::CAPTURE_INPUT));
 
 		addOutput(createOutputCentered<gui::AHPort>(Vec(36.028, 228.311), module, Arp31::GATE_OUTPUT));
 		addOutput(createOutputCentered<gui::AHPort>(Vec(103.309, 228.311), module, Arp31::EOC_OUTPUT));
@@ -982,6 +1427,116 @@ struct Arp31Widget : ModuleWidget {
 			}
 		};
 
+		struct SwitchModeItem : Arp31Menu {
+			digital::PatternSwitch::Mode mode;
+			int bars;
+			void onAction(const rack::widget::Widget::ActionEvent &e) override {
+				module->patternSwitch.mode = mode;
+				module->patternSwitch.bars = bars;
+			}
+		};
+
+		struct SwitchModeMenu : Arp31Menu {
+			Menu *createChildMenu() override {
+				Menu *menu = new Menu;
+				std::vector<digital::PatternSwitch::Mode> modes = {digital::PatternSwitch::IMMEDIATE, digital::PatternSwitch::AT_EOC, 
+					digital::PatternSwitch::AT_BARS, digital::PatternSwitch::AT_BARS, digital::PatternSwitch::AT_BARS};
+				std::vector<int> bars = {1, 1, 1, 2, 4};
+				std::vector<std::string> names = {"Immediately", "At end of cycle", "Every bar", "Every 2 bars", "Every 4 bars"};
+				for (size_t i = 0; i < modes.size(); i++) {
+					bool checked = module->patternSwitch.mode == modes[i] && (modes[i] != digital::PatternSwitch::AT_BARS || module->patternSwitch.bars == bars[i]);
+					SwitchModeItem *item = createMenuItem<SwitchModeItem>(names[i], CHECKMARK(checked));
+					item->module = module;
+					item->mode = modes[i];
+					item->bars = bars[i];
+					menu->addChild(item);
+				}
+				return menu;
+			}
+		};
+
+		struct BankItem : Arp31Menu {
+			int bank;
+			void onAction(const rack::widget::Widget::ActionEvent &e) override {
+				module->selectedBank = bank;
+			}
+		};
+
+		struct BankMenu : Arp31Menu {
+			Menu *createChildMenu() override {
+				Menu *menu = new Menu;
+				BankItem *item = createMenuItem<BankItem>("Input pitches", CHECKMARK(module->selectedBank == -1));
+				item->module = module;
+				item->bank = -1;
+				menu->addChild(item);
+				for (int b = 0; b < Arp31::NUM_BANKS; b++) {
+					std::string name = "Bank " + std::to_string(b + 1);
+					name += module->banks[b].empty() ? " (empty)" : " (" + std::to_string(module->banks[b].size()) + " notes)";
+					BankItem *item = createMenuItem<BankItem>(name, CHECKMARK(module->selectedBank == b));
+					item->module = module;
+					item->bank = b;
+					menu->addChild(item);
+				}
+				return menu;
+			}
+		};
+
+		struct RatchetItem : Arp31Menu {
+			int ratchets;
+			void onAction(const rack::widget::Widget::ActionEvent &e) override {
+				module->scheduler.ratchets = ratchets;
+			}
+		};
+
+		struct RatchetMenu : Arp31Menu {
+			Menu *createChildMenu() override {
+				Menu *menu = new Menu;
+				std::vector<int> counts = {1, 2, 3, 4, 6, 8};
+				for (size_t i = 0; i < counts.size(); i++) {
+					std::string name = counts[i] == 1 ? "Off" : std::to_string(counts[i]) + " per step";
+					RatchetItem *item = createMenuItem<RatchetItem>(name, CHECKMARK(module->scheduler.ratchets == counts[i]));
+					item->module = module;
+					item->ratchets = counts[i];
+					menu->addChild(item);
+				}
+				return menu;
+			}
+		};
+
+		struct SwingItem : Arp31Menu {
+			int swing;
+			void onAction(const rack::widget::Widget::ActionEvent &e) override {
+				module->scheduler.swing = swing;
+			}
+		};
+
+		struct SwingMenu : Arp31Menu {
+			Menu *createChildMenu() override {
+				Menu *menu = new Menu;
+				std::vector<int> amounts = {50, 54, 58, 62, 66, 71, 75};
+				for (size_t i = 0; i < amounts.size(); i++) {
+					std::string name = amounts[i] == 50 ? "Off" : std::to_string(amounts[i]) + "%";
+					SwingItem *item = createMenuItem<SwingItem>(name, CHECKMARK(module->scheduler.swing == amounts[i]));
+					item->module = module;
+					item->swing = amounts[i];
+					menu->addChild(item);
+				}
+				return menu;
+			}
+		};
+
+		struct PolyClockItem : Arp31Menu {
+			void onAction(const rack::widget::Widget::ActionEvent &e) override {
+				module->polyClock ^= true;
+			}
+		};
+
+		struct SplitChordItem : Arp31Menu {
+			void onAction(const rack::widget::Widget::ActionEvent &e) override {
+				module->splitChord ^= true;
+			}
+		};
+
 		menu->addChild(construct<MenuLabel>());
 		GateModeMenu *gitem = createMenuItem<GateModeMenu>("Gate Mode");
 		gitem->module = arp;
@@ -993,6 +1548,42 @@ struct Arp31Widget : ModuleWidget {
 		ritem->parent = this;
 		menu->addChild(ritem);
 
+		SwitchModeMenu *switem = createMenuItem<SwitchModeMenu>("Switch to a changed arpeggio");
+		switem->module = arp;
+		switem->parent = this;
+		menu->addChild(switem);
+
+		RatchetMenu *rtitem = createMenuItem<RatchetMenu>("Ratchets");
+		rtitem->module = arp;
+		rtitem->parent = this;
+		menu->addChild(rtitem);
+
+		SwingMenu *switem2 = createMenuItem<SwingMenu>("Swing");
+		switem2->module = arp;
+		switem2->parent = this;
+		menu->addChild(switem2);
+
+		BankMenu *bitem = createMenuItem<BankMenu>("Chord bank (without CV)");
+		bitem->module = arp;
+		bitem->parent = this;
+		menu->addChild(bitem);
+
+		menu->addChild(construct<MenuLabel>());
+		PolyClockItem *pitem = createMenuItem<PolyClockItem>("Independent lane per clock channel", CHECKMARK(arp->polyClock));
+		pitem->module = arp;
+		menu->addChild(pitem);
+
+		SplitChordItem *sitem = createMenuItem<SplitChordItem>("Split chord across lanes", CHECKMARK(arp->splitChord));
+		sitem->module = arp;
+		menu->addChild(sitem);
+
+#ifndef METAMODULE
+		menu->addChild(construct<MenuLabel>());
+		gui::TraceItem *titem = createMenuItem<gui::TraceItem>("Debug trace to file", CHECKMARK(arp->debugFlag));
+		titem->module = arp;
+		menu->addChild(titem);
+#endif
+
      }
 	 
 };
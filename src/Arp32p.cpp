@@ -1,6 +1,8 @@
 #include "AH.hpp"
 #include "AHCommon.hpp"
 
+#include <cctype>
+#include <climits>
 #include <iostream>
 
 using namespace ah;
@@ -16,8 +18,6 @@ struct Pattern2 {
 	unsigned int patternOffset = 0;
 	bool repeatLast = false;
 
-	unsigned int index = 0;
-
 	unsigned int MAJOR[7] = {0,2,4,5,7,9,11};
 	unsigned int MINOR[7] = {0,2,3,5,7,8,10};
 		
@@ -31,26 +31,6 @@ struct Pattern2 {
 		repeatLast = _repeat;
 	};
 
-	void advance() {
-		// std::cout << "ADV " << index << std::endl;
-		index++;
-	};
-
-	void reset() {
-		// std::cout << "RES" << std::endl;
-		index = patternOffset;
-	}
-
-	int getOffset() {
-		// std::cout << "OUT " << index << " " << notes[index] << std::endl;
-		return notes[index];
-	}
-
-	bool isPatternFinished() {
-		// std::cout << "FIN " << index << " " << nNotes << std::endl;
-		return (index >= nNotes - 1); 
-	}
-
 	int getMajor(int count) {
 		int i = abs(count);
 		int sign = (count < 0) ? -1 : (count > 0);
@@ -63,31 +43,6 @@ struct Pattern2 {
 		return sign * ((i / 7) * 12 + MINOR[i % 7]);
 	}
 
-	void randomize() {
-		int length = nNotes - patternOffset;
-		int p1 = (rand() % length) + patternOffset;
-		int p2 = (rand() % length) + patternOffset;
-		int tries = 0;
-
-		while (p1 == p2 && tries < 5) { // Make some effort to change the sequence, break after 5 attempts
-			p2 = (rand() % length) + patternOffset;
-			tries++;
-		}
-
-		// std::cout << "RND " << length << " " << p1 << " " << p2 << " "; 
-
-		unsigned int t = notes[p1];
-		notes[p1] = notes[p2];
-		notes[p2] = t;
-
-		// for (int i = 0; i < nPitches; i++) {
-		// 	std::cout << indexes[i];
-		// }
-
-		// std::cout << std::endl;
-
-	}
-
 };
 
 struct DivergePattern2 : Pattern2 {
@@ -124,7 +79,6 @@ struct DivergePattern2 : Pattern2 {
 
 		nNotes = notes.size();
 		patternOffset = patternOffset % nNotes;
-		index = patternOffset;
 		// std::cout << " NP=" << nNotes << " -> " << index << std::endl;
 
 	}
@@ -165,7 +119,6 @@ struct ConvergePattern2 : Pattern2 {
 
 		nNotes = notes.size();
 		patternOffset = patternOffset % nNotes;
-		index = patternOffset;
 		// std::cout << " NP=" << nNotes << " -> " << index << std::endl;
 
 	}
@@ -223,7 +176,6 @@ struct ReturnPattern2 : Pattern2 {
 
 		nNotes = notes.size();
 		patternOffset = patternOffset % nNotes;
-		index = patternOffset;
 		// std::cout << " NP=" << nNotes << " -> " << index << std::endl;
 
 	}
@@ -282,7 +234,6 @@ struct BouncePattern2 : Pattern2 {
 
 		nNotes = notes.size();
 		patternOffset = patternOffset % nNotes;
-		index = patternOffset;
 		// std::cout << " NP=" << nNotes << " -> " << index << std::endl;
 
 	}
@@ -297,7 +248,6 @@ struct NotePattern2 : Pattern2 {
 
 		nNotes = notes.size();
 		patternOffset = patternOffset % nNotes;
-		index = patternOffset;
 
 	}
 
@@ -355,10 +305,446 @@ struct OnTheRunPattern2 : NotePattern2 {
 	
 };
 
+// User patterns are written in a small language and compiled on the UI thread into ArpProgram bytecode. Tokens are
+// separated by spaces:
+//   3         play step 3, scaled by the step size and scale like the built-in patterns
+//   +2 -1     move up or down from the last step and play it
+//   .         rest for a clock
+//   [ ... ]4  repeat the enclosed steps 4 times, twice if no count is given
+//   { a | b } take one branch at random each time through
+//   < a | b > take the next branch each time the pattern completes
+// e.g. "0 [+2 +1]3 < 7 . | 5 4 > { 0 | 12 }"
+struct ArpProgram {
+
+	const static int MAX_OPS = 128;
+	const static int MAX_DEPTH = 8;
+	const static int MAX_NOTES = 256;
+	const static int MAX_INSTRUCTIONS = 4096; // Per cycle, bounds nested repeats
+	const static int MAX_STEP = 999; // As far as a written step reaches, moves are held within it
+	const static int REST = INT_MIN; // Out of reach of any step, even once scaled by the step size
+
+	enum Opcode {
+		END,
+		NOTE,	// arg = step
+		MOVE,	// arg = interval from last step
+		PAUSE,
+		LOOP,	// arg = count
+		NEXT,	// target = first op of the loop body
+		RANDOM,	// arg = number of branches, each followed by a JUMP to its body
+		CYCLE,	// arg = number of branches, as RANDOM
+		JUMP	// target
+	};
+
+	struct Op {
+		uint8_t code;
+		int16_t arg;
+		uint16_t target;
+	};
+
+	Op ops[MAX_OPS];
+	int nOps = 0;
+
+	// Run one cycle of the program into a list of steps, REST marking a clock without a note. The list must have
+	// room for MAX_NOTES entries, nothing is allocated here
+	void run(unsigned int cycle, std::vector<int> &steps) const {
+
+		int counts[MAX_DEPTH];
+		int depth = 0;
+		int step = 0;
+		int pc = 0;
+
+		for (int executed = 0; executed < MAX_INSTRUCTIONS && pc < nOps; executed++) {
+
+			const Op &op = ops[pc];
+
+			switch (op.code) {
+				case NOTE:
+					step = op.arg;
+					steps.push_back(step);
+					pc++;
+					break;
+				case MOVE:
+					step = clamp(step + op.arg, -MAX_STEP, MAX_STEP);
+					steps.push_back(step);
+					pc++;
+					break;
+				case PAUSE:
+					steps.push_back(REST);
+					pc++;
+					break;
+				case LOOP:
+					counts[depth++] = op.arg;
+					pc++;
+					break;
+				case NEXT:
+					if (--counts[depth - 1] > 0) {
+						pc = op.target;
+					} else {
+						depth--;
+						pc++;
+					}
+					break;
+				case RANDOM:
+					pc = pc + 1 + rand() % op.arg;
+					break;
+				case CYCLE:
+					pc = pc + 1 + cycle % op.arg;
+					break;
+				case JUMP:
+					pc = op.target;
+					break;
+				default: // END
+					return;
+			}
+
+			if (steps.size() >= (size_t)MAX_NOTES) {
+				return;
+			}
+		}
+	}
+
+};
+
+const int ArpProgram::REST;
+
+// Turns pattern text into bytecode, reporting the first problem found
+struct ArpProgramCompiler {
+
+	std::vector<std::string> tokens;
+	size_t pos = 0;
+	int depth = 0;
+	int nNotes = 0;
+	std::string error;
+
+	bool compile(const std::string &source, ArpProgram &program) {
+
+		tokenise(source);
+		pos = 0;
+		depth = 0;
+		nNotes = 0;
+		error.clear();
+		program.nOps = 0;
+
+		if (!sequence(program, "")) {
+			return false;
+		}
+
+		if (nNotes == 0) {
+			error = "Pattern has no steps";
+			return false;
+		}
+
+		return emit(program, ArpProgram::END, 0);
+
+	}
+
+	void tokenise(const std::string &source) {
+		tokens.clear();
+		size_t i = 0;
+		while (i < source.size()) {
+			char c = source[i];
+			if (isspace((unsigned char) c)) {
+				i++;
+			} else if (c == ']') { // Keep a repeat count attached to its bracket
+				size_t j = i + 1;
+				while (j < source.size() && isdigit((unsigned char) source[j])) {
+					j++;
+				}
+				tokens.push_back(source.substr(i, j - i));
+				i = j;
+			} else if (strchr("[{}<>|.", c)) {
+				tokens.push_back(std::string(1, c));
+				i++;
+			} else {
+				size_t j = i + 1;
+				while (j < source.size() && !isspace((unsigned char) source[j]) && !strchr("[]{}<>|.", source[j])) {
+					j++;
+				}
+				tokens.push_back(source.substr(i, j - i));
+				i = j;
+			}
+		}
+	}
+
+	bool emit(ArpProgram &program, int code, int arg, int target = 0) {
+		if (program.nOps >= ArpProgram::MAX_OPS) {
+			error = "Pattern is too long";
+			return false;
+		}
+		ArpProgram::Op &op = program.ops[program.nOps++];
+		op.code = code;
+		op.arg = arg;
+		op.target = target;
+		return true;
+	}
+
+	bool number(const std::string &token, size_t start, int &value) {
+		if (start >= token.size() || token.size() - start > 3) {
+			return false;
+		}
+		value = 0;
+		for (size_t i = start; i < token.size(); i++) {
+			if (!isdigit((unsigned char) token[i])) {
+				return false;
+			}
+			value = value * 10 + (token[i] - '0');
+		}
+		return true;
+	}
+
+	// Parse until one of the closing tokens, which is left for the caller
+	bool sequence(ArpProgram &program, const char *closers) {
+
+		while (pos < tokens.size()) {
+
+			const std::string &token = tokens[pos];
+
+			if (strchr(closers, token[0]) && (token.size() == 1 || token[0] == ']')) {
+				return true;
+			}
+			if (token[0] == ']' || token == "}" || token == ">" || token == "|") {
+				error = "Unexpected '" + token + "'";
+				return false;
+			}
+
+			pos++;
+			int value;
+
+			if (token == ".") {
+				if (!emit(program, ArpProgram::PAUSE, 0)) return false;
+			} else if (token == "[") {
+				if (!repeat(program)) return false;
+			} else if (token == "{") {
+				if (!branches(program, ArpProgram::RANDOM, '}')) return false;
+			} else if (token == "<") {
+				if (!branches(program, ArpProgram::CYCLE, '>')) return false;
+			} else if ((token[0] == '+' || token[0] == '-') && number(token, 1, value)) {
+				if (!emit(program, ArpProgram::MOVE, token[0] == '-' ? -value : value)) return false;
+				nNotes++;
+			} else if (number(token, 0, value)) {
+				if (!emit(program, ArpProgram::NOTE, value)) return false;
+				nNotes++;
+			} else {
+				error = "Unknown step '" + token + "'";
+				return false;
+			}
+		}
+
+		if (closers[0]) {
+			error = std::string("Missing '") + closers[0] + "'";
+			return false;
+		}
+
+		return true;
+
+	}
+
+	bool repeat(ArpProgram &program) {
+
+		if (++depth > ArpProgram::MAX_DEPTH) {
+			error = "Repeats are nested too deeply";
+			return false;
+		}
+
+		int loop = program.nOps;
+		if (!emit(program, ArpProgram::LOOP, 2)) return false;
+		if (!sequence(program, "]")) return false;
+
+		int count = 2;
+		const std::string &token = tokens[pos++];
+		if (token.size() > 1 && (!number(token, 1, count) || count < 1)) {
+			error = "Bad repeat count '" + token + "'";
+			return false;
+		}
+
+		program.ops[loop].arg = count;
+		depth--;
+		return emit(program, ArpProgram::NEXT, 0, loop + 1);
+
+	}
+
+	bool branches(ArpProgram &program, int code, char closer) {
+
+		std::string closers = std::string("|") + closer;
+
+		// Count the branches first so the jump table can be laid out ahead of them
+		int n = 1;
+		int nesting = 0;
+		for (size_t i = pos; i < tokens.size(); i++) {
+			const std::string &token = tokens[i];
+			if (token == "{" || token == "<" || token == "[") {
+				nesting++;
+			} else if (nesting > 0 && (token == "}" || token == ">" || token[0] == ']')) {
+				nesting--;
+			} else if (nesting == 0 && token == "|") {
+				n++;
+			} else if (nesting == 0 && token[0] == closer) {
+				break;
+			}
+		}
+
+		int table = program.nOps;
+		if (!emit(program, code, n)) return false;
+		for (int b = 0; b < n; b++) {
+			if (!emit(program, ArpProgram::JUMP, 0)) return false;
+		}
+
+		std::vector<int> exits(n);
+		for (int b = 0; b < n; b++) {
+			program.ops[table + 1 + b].target = program.nOps;
+			if (!sequence(program, closers.c_str())) return false;
+			exits[b] = program.nOps;
+			if (!emit(program, ArpProgram::JUMP, 0)) return false;
+			pos++; // Past the '|' or closer
+		}
+
+		for (int b = 0; b < n; b++) {
+			program.ops[exits[b]].target = program.nOps;
+		}
+
+		return true;
+
+	}
+
+};
+
+// Builds a cycle of a user pattern by running its bytecode, cycle counts the cycles played so far
+struct ProgramPattern2 : Pattern2 {
+
+	const std::string name = "Custom";
+
+	const ArpProgram *program = NULL;
+	unsigned int cycle = 0;
+
+	ProgramPattern2() {
+		notes.reserve(ArpProgram::MAX_NOTES);
+	}
+
+	const std::string & getName() override {
+		return name;
+	};
+
+	void initialise(unsigned int _length, unsigned int _scale, int _size, unsigned int _offset, bool _repeat) override {
+
+		Pattern2::initialise(_length, _scale, _size, _offset, _repeat);
+
+		notes.clear();
+		if (program) {
+			program->run(cycle, notes);
+		}
+
+		for (size_t i = 0; i < notes.size(); i++) {
+			if (notes[i] == ArpProgram::REST) {
+				continue;
+			}
+			switch(stepScale) {
+				case 1: notes[i] = getMajor(notes[i] * stepSize); break;
+				case 2: notes[i] = getMinor(notes[i] * stepSize); break;
+				default:
+					notes[i] = notes[i] * stepSize; break;
+			}
+		}
+
+		if (notes.empty()) {
+			notes.push_back(ArpProgram::REST);
+		}
+
+		nNotes = notes.size();
+		patternOffset = patternOffset % nNotes;
+
+	}
+
+};
+
+// A cycle of notes ready to play, copied out of the pattern that built it. Arp32 plays one while the next is prepared
+// between clocks, so that a clock only has to swap them over
+struct Arp32Cycle {
+
+	// The inputs the cycle was built from, to tell when they have moved on
+	struct Key {
+		int custom;
+		int pattern;
+		int length;
+		int size;
+		int scale;
+		int offset;
+		int repeat;
+		int version;
+
+		bool operator==(const Key &other) const {
+			return std::memcmp(this, &other, sizeof(Key)) == 0;
+		}
+	};
+
+	Key key;
+	std::vector<int> notes;
+	unsigned int nNotes = 1;
+	unsigned int patternOffset = 0;
+	unsigned int index = 0;
+
+	Arp32Cycle() {
+		std::memset(&key, 0, sizeof(Key));
+		key.pattern = -1; // Nothing built yet, so never matches the inputs
+		notes.reserve(ArpProgram::MAX_NOTES);
+		notes.push_back(0);
+	}
+
+	void assign(const Key &_key, const Pattern2 &pattern) {
+		key = _key;
+		notes.assign(pattern.notes.begin(), pattern.notes.end());
+		nNotes = notes.size();
+		patternOffset = pattern.patternOffset;
+		index = patternOffset;
+	}
+
+	void advance() {
+		index++;
+	};
+
+	void reset() {
+		index = patternOffset;
+	}
+
+	int getOffset() {
+		return notes[index];
+	}
+
+	bool isPatternFinished() {
+		return (index >= nNotes - 1); 
+	}
+
+	void randomize() {
+		int length = nNotes - patternOffset;
+		int p1 = (rand() % length) + patternOffset;
+		int p2 = (rand() % length) + patternOffset;
+		int tries = 0;
+
+		while (p1 == p2 && tries < 5) { // Make some effort to change the sequence, break after 5 attempts
+			p2 = (rand() % length) + patternOffset;
+			tries++;
+		}
+
+		int t = notes[p1];
+		notes[p1] = notes[p2];
+		notes[p2] = t;
+	}
+
+};
+
+static const char *const ARP32_TRACE_NAMES[] = {
+	"No pitch input, aborting",
+	"Advance cycle: offset",
+	"Finished cycle",
+	"Step: V, rest",
+	"New cycle: pattern, length",
+	"Hold cycle: pattern, length"
+};
+
 struct Arp32 : core::AHModule {
 
 	const static int MAX_STEPS = 16;
 	const static int MAX_DIST = 12; // Octave
+	const static int MAX_PROGRAMS = 32;
 
 	enum ParamIds {
 		PATT_PARAM,
@@ -388,6 +774,16 @@ struct Arp32 : core::AHModule {
 		NUM_LIGHTS
 	};
 
+	enum TraceIds {
+		TRACE_NO_INPUT,
+		TRACE_ADVANCE,
+		TRACE_FINISHED,
+		TRACE_STEP,
+		TRACE_NEW_CYCLE,
+		TRACE_HOLD_CYCLE,
+		NUM_TRACES
+	};
+
 	Arp32() : core::AHModule(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS) {
 		configParam(PATT_PARAM, 0.0, 5.0, 0.0, "Pattern"); 
 
@@ -422,17 +818,16 @@ struct Arp32 : core::AHModule {
 		patterns.push_back(&patt_rez);
 		patterns.push_back(&patt_ontherun);
 
-		nextPattern = patterns[0]->getName();
-
 		onReset();
-		id = rand();
-		debugFlag = false;
+		setTraceNames(ARP32_TRACE_NAMES, NUM_TRACES);
 	}
 
 	void process(const ProcessArgs &args) override;
 
 	void onReset() override {
 		isRunning = false;
+		patternSwitch.reset();
+		scheduler.reset();
 	}
 
 	json_t *dataToJson() override {
@@ -446,6 +841,39 @@ struct Arp32 : core::AHModule {
 		json_t *repeatModeJ = json_boolean((bool) repeatEnd);
 		json_object_set_new(rootJ, "repeatMode", repeatModeJ);
 
+		// switchMode
+		json_t *switchModeJ = json_integer((int) patternSwitch.mode);
+		json_object_set_new(rootJ, "switchMode", switchModeJ);
+
+		// switchBars
+		json_t *switchBarsJ = json_integer(patternSwitch.bars);
+		json_object_set_new(rootJ, "switchBars", switchBarsJ);
+
+		// customPatterns
+		json_t *customPatternsJ = json_boolean(customPatterns);
+		json_object_set_new(rootJ, "customPatterns", customPatternsJ);
+
+		// programs
+		int nSources = 0;
+		for (int i = 0; i < MAX_PROGRAMS; i++) {
+			if (!programSources[i].empty()) {
+				nSources = i + 1;
+			}
+		}
+		json_t *programsJ = json_array();
+		for (int i = 0; i < nSources; i++) {
+			json_array_append_new(programsJ, json_string(programSources[i].c_str()));
+		}
+		json_object_set_new(rootJ, "programs", programsJ);
+
+		// ratchets
+		json_t *ratchetsJ = json_integer(scheduler.ratchets);
+		json_object_set_new(rootJ, "ratchets", ratchetsJ);
+
+		// swing
+		json_t *swingJ = json_integer(scheduler.swing);
+		json_object_set_new(rootJ, "swing", swingJ);
+
 		return rootJ;
 	}
 
@@ -457,6 +885,63 @@ struct Arp32 : core::AHModule {
 		// repeatMode
 		json_t *repeatModeJ = json_object_get(rootJ, "repeatMode");
 		if (repeatModeJ) repeatEnd = json_boolean_value(repeatModeJ);
+
+		// switchMode
+		json_t *switchModeJ = json_object_get(rootJ, "switchMode");
+		if (switchModeJ) patternSwitch.mode = (digital::PatternSwitch::Mode)json_integer_value(switchModeJ);
+
+		// switchBars
+		json_t *switchBarsJ = json_object_get(rootJ, "switchBars");
+		if (switchBarsJ) patternSwitch.bars = std::max((int)json_integer_value(switchBarsJ), 1);
+
+		// customPatterns
+		json_t *customPatternsJ = json_object_get(rootJ, "customPatterns");
+		if (customPatternsJ) customPatterns = json_boolean_value(customPatternsJ);
+
+		// ratchets
+		json_t *ratchetsJ = json_object_get(rootJ, "ratchets");
+		if (ratchetsJ) scheduler.ratchets = clamp((int)json_integer_value(ratchetsJ), 1, 8);
+
+		// swing
+		json_t *swingJ = json_object_get(rootJ, "swing");
+		if (swingJ) scheduler.swing = clamp((int)json_integer_value(swingJ), 50, 75);
+
+		// programs
+		json_t *programsJ = json_object_get(rootJ, "programs");
+		if (programsJ) {
+			for (int i = 0; i < MAX_PROGRAMS; i++) {
+				json_t *programJ = json_array_get(programsJ, i);
+				setProgram(i, programJ ? json_string_value(programJ) : "");
+			}
+		}
+	}
+
+	// Compile a user pattern and hand it to the audio thread. UI thread only
+	void setProgram(int slot, const std::string &source) {
+
+		// Opening the menu sets the text fields, which lands here unchanged
+		if (source == programSources[slot] && programErrors[slot].empty()) {
+			return;
+		}
+
+		programSources[slot] = source;
+
+		ProgramLoad load;
+		load.slot = slot;
+
+		if (source.empty()) {
+			programErrors[slot].clear();
+		} else if (!compiler.compile(source, load.program)) {
+			programErrors[slot] = compiler.error;
+			return; // Keep playing the last good version
+		} else {
+			programErrors[slot].clear();
+		}
+
+		if (!programLoads.push(load)) {
+			programErrors[slot] = "Busy, edit again to retry";
+		}
+
 	}
 
 	enum GateMode {
@@ -472,8 +957,8 @@ struct Arp32 : core::AHModule {
 	rack::dsp::PulseGenerator gatePulse;
 	rack::dsp::PulseGenerator eocPulse;
 
-	int id = 0;
 	float outVolts = 0;
+	float stepVolts = 0;
 	float rootPitch = 0.0;
 	bool isRunning = false;
 	bool eoc = false;
@@ -484,10 +969,6 @@ struct Arp32 : core::AHModule {
 	int inputSize = 0;
 	unsigned int inputScale = 0;
 
-	int pattern = 0;
-	int length = 0;
-	float size = 0;
-	float scale = 0;
 	int offset = 0;
 
 	std::vector<Pattern2 *>patterns;
@@ -499,8 +980,97 @@ struct Arp32 : core::AHModule {
 	RezPattern2 			patt_rez;
 	OnTheRunPattern2		patt_ontherun;
 
-	Pattern2 *currPatt = &patt_diverge;
-	std::string nextPattern;
+	ProgramPattern2			patt_program;
+
+	// The cycle playing and the one that replaces it, built from the inputs as they change
+	Arp32Cycle cycles[2];
+	Arp32Cycle *currCycle = &cycles[0];
+	Arp32Cycle *nextCycle = &cycles[1];
+	bool nextReady = false;
+	unsigned int programCycle = 0;
+	int programVersion = 0;
+
+	digital::PatternSwitch patternSwitch;
+	digital::StepScheduler scheduler;
+
+	// User patterns. The sources and compiler belong to the UI thread, the compiled programs to the audio thread
+	struct ProgramLoad {
+		int slot = 0;
+		ArpProgram program;
+	};
+
+	bool customPatterns = false;
+	std::string programSources[MAX_PROGRAMS];
+	std::string programErrors[MAX_PROGRAMS];
+	ArpProgramCompiler compiler;
+	core::EventQueue<ProgramLoad, MAX_PROGRAMS> programLoads;
+	ArpProgram programs[MAX_PROGRAMS];
+
+	// State shown on the panel, published for the widget
+	struct DisplayState {
+		int custom;
+		int pattern;
+		int length;
+		int size;
+		int scale;
+		int offset;
+		int index;
+		float pitch;
+	};
+
+	core::DisplaySnapshot<DisplayState> display;
+
+	void publishDisplay(bool custom) {
+		DisplayState state;
+		state.custom = custom;
+		state.pattern = inputPat;
+		state.length = inputLen;
+		state.size = inputSize;
+		state.scale = inputScale;
+		state.offset = offset;
+		state.index = currCycle->index;
+		state.pitch = outVolts;
+		display.publish(state);
+	}
+
+	Arp32Cycle::Key inputKey(bool custom) {
+		Arp32Cycle::Key key;
+		std::memset(&key, 0, sizeof(Arp32Cycle::Key));
+		key.custom = custom;
+		key.pattern = inputPat;
+		key.length = inputLen;
+		key.size = inputSize;
+		key.scale = inputScale;
+		key.offset = offset;
+		key.repeat = repeatEnd;
+		key.version = custom ? programVersion : 0;
+		return key;
+	}
+
+	// Build the next cycle from the pattern generators
+	void prepareNext(const Arp32Cycle::Key &key) {
+		Pattern2 *patt;
+		if (key.custom) {
+			patt_program.program = &programs[key.pattern];
+			patt_program.cycle = programCycle;
+			patt = &patt_program;
+		} else {
+			patt = patterns[key.pattern];
+		}
+		patt->initialise(key.length, key.scale, key.size, key.offset, key.repeat);
+		nextCycle->assign(key, *patt);
+		nextReady = true;
+	}
+
+	// Make the next cycle current, building it now if the inputs moved since it was prepared
+	void swapCycles(const Arp32Cycle::Key &key) {
+		if (!nextReady || !(nextCycle->key == key)) {
+			prepareNext(key);
+		}
+		std::swap(currCycle, nextCycle);
+		nextReady = false;
+		programCycle++;
+	}
 
 };
 
@@ -518,8 +1088,25 @@ void Arp32::process(const ProcessArgs &args) {
 	float clockActive	= inputs[CLOCK_INPUT].isConnected();
 	float randomInput	= inputs[RANDOM_INPUT].getVoltage();
 
+	// Pick up newly compiled user patterns
+	ProgramLoad load;
+	while (programLoads.pop(load)) {
+		programs[load.slot] = load.program;
+		programVersion++;
+	}
+
+	// The menu can flip this at any time, so read it once and use the same value for the pattern and the display
+	bool custom = customPatterns;
+
 	// Read param section	
-	if (inputs[PATT_INPUT].isConnected()) {
+	if (custom) {
+		// One user pattern per semitone on the input, the knob reaches the first six
+		if (inputs[PATT_INPUT].isConnected()) {
+			inputPat = std::min(std::max(static_cast<int>(std::round(inputs[PATT_INPUT].getVoltage() * 12.0f)), 0), MAX_PROGRAMS - 1);
+		} else {
+			inputPat = params[PATT_PARAM].getValue();
+		}
+	} else if (inputs[PATT_INPUT].isConnected()) {
 		inputPat = clamp(static_cast<unsigned int>(inputs[PATT_INPUT].getVoltage()), 0, 5);
 	} else {
 		inputPat = params[PATT_PARAM].getValue();
@@ -545,11 +1132,17 @@ void Arp32::process(const ProcessArgs &args) {
 	bool clockStatus = clockTrigger.process(clockInput);
 	bool randomStatus = randomTrigger.process(randomInput);
 
+	// Keep the next cycle up to date with the inputs, away from the clock edges
+	Arp32Cycle::Key key = inputKey(custom);
+	if (controlDue && !clockStatus && (!nextReady || !(nextCycle->key == key))) {
+		prepareNext(key);
+	}
+	bool pending = !(currCycle->key == key);
+
 	// Need to understand why this happens
 	if (inputLen == 0) {
-		#ifndef METAMODULE
-		if (debugEnabled(5000)) { std::cout << stepX << " " << id  << " InputLen == 0, aborting" << std::endl; }
-		#endif
+		if (debugEnabled(5000)) { trace(TRACE_NO_INPUT); }
+		publishDisplay(custom);
 		return; // No inputs, no music
 	}
 
@@ -563,6 +1156,10 @@ void Arp32::process(const ProcessArgs &args) {
 	// Have we been clocked?
 	if (clockStatus) {
 
+		scheduler.clock();
+
+		bool switchNow = patternSwitch.clock();
+
 		// EOC was fired at last sequence step
 		if (eoc) {
 			eocPulse.trigger(digital::TRIGGER);
@@ -572,41 +1169,43 @@ void Arp32::process(const ProcessArgs &args) {
 		// If we are already running, process cycle
 		if (isRunning) {
 
-			#ifndef METAMODULE
-			#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " " << id  << " Advance Cycle: " << currPatt->getOffset() << std::endl; }
-#endif
-			#endif
+			// Take up a changed pattern straight away or at the bar, from its start
+			if (switchNow && pending && !hold) {
+				swapCycles(key);
+				pending = false;
+			}
+
+			trace(TRACE_ADVANCE, currCycle->getOffset());
 
 			// Reached the end of the pattern?
-			if (currPatt->isPatternFinished()) {
+			if (currCycle->isPatternFinished()) {
 
 				// Trigger EOC mechanism
 				eoc = true;
 
-				#ifndef METAMODULE
-				#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " " << id  << " Finished Cycle" << std::endl; }
-#endif
-				#endif
+				trace(TRACE_FINISHED);
 				restart = true;
 
 			} 
 
-			// Finally set the out voltage
-			outVolts = clamp(rootPitch + music::SEMITONE * (float)currPatt->getOffset(), -10.0f, 10.0f);
+			// Finally set the out voltage, unless a user pattern rests on this step
+			int note = currCycle->getOffset();
+			bool rest = (note == ArpProgram::REST);
+			if (!rest) {
+				stepVolts = clamp(rootPitch + music::SEMITONE * (float)note, -10.0f, 10.0f);
+			}
 
-			#ifndef METAMODULE	
-			#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " " << id  << " Output V = " << outVolts << std::endl; }
-#endif
-			#endif
+			trace(TRACE_STEP, stepVolts, rest);
 
-			// Pulse the output gate
-			gatePulse.trigger(digital::TRIGGER);
+			// Pulse the output gate, or start the ratchets
+			if (rest) {
+				scheduler.rest();
+			} else {
+				scheduler.schedule();
+			}
 
 			// Completed 1 step
-			currPatt->advance();
+			currCycle->advance();
 
 		} else {
 
@@ -619,7 +1218,7 @@ if (debugEnabled()) { std::cout << stepX << " " << id  << " Output V = " << outV
 
 	// Randomise if triggered
 	if (randomStatus && isRunning && hold != -1) {
-		currPatt->randomize();
+		currCycle->randomize();
 	}
 
 	// If we have been triggered, start a new sequence
@@ -636,36 +1235,23 @@ if (debugEnabled()) { std::cout << stepX << " " << id  << " Output V = " << outV
 			}
 
 			// At the first step of the cycle
-			// So this is where we tweak the cycle parameters
-			pattern = inputPat;
-			length = inputLen;
-			size = inputSize;
-			scale = inputScale;
-
-			currPatt = patterns[pattern];
+			// So this is where we take up the prepared cycle, unless a changed pattern is waiting for the bar
+			if (!isRunning || !pending || patternSwitch.atEndOfCycle()) {
+				swapCycles(key);
+			} else {
+				currCycle->reset();
+			}
 
 			// Save pitch
 			rootPitch = inputPitch;
 
-			#ifndef METAMODULE
-			if (debugEnabled()) { std::cout << stepX << " " << id  << 
-				" Initiatise new Cycle: Pattern: " << currPatt->getName() << 
-				" Length: " << inputLen << std::endl; 
-			}
-			#endif
-
-			currPatt->initialise(length, scale, size, offset, repeatEnd);
+			trace(TRACE_NEW_CYCLE, currCycle->key.pattern, inputLen);
 
 		} else {
 
-			#ifndef METAMODULE
-			if (debugEnabled()) { std::cout << stepX << " " << id  << 
-				" Hold new Cycle: Pattern: " << currPatt->getName() << 
-				" Length: " << inputLen << std::endl; 
-			}
-			#endif
+			trace(TRACE_HOLD_CYCLE, currCycle->key.pattern, inputLen);
 
-			currPatt->reset();
+			currCycle->reset();
 
 		}
 
@@ -674,7 +1260,13 @@ if (debugEnabled()) { std::cout << stepX << " " << id  << " Output V = " << outV
 
 	} 
 
-	nextPattern = patterns[inputPat]->getName();
+	// Play the step, or its next ratchet
+	if (scheduler.process()) {
+		outVolts = stepVolts;
+		gatePulse.trigger(digital::TRIGGER);
+	}
+
+	publishDisplay(custom);
 
 	// Set the value
 	outputs[OUT_OUTPUT].setVoltage(outVolts);
@@ -694,6 +1286,8 @@ if (debugEnabled()) { std::cout << stepX << " " << id  << " Output V = " << outV
 
 }
 
+static const char *const ARP32_NAMES[6] = {"Diverge", "Converge", "Return", "Bounce", "Rez", "On The Run"};
+
 struct Arp32Display : TransparentWidget {
 
 	Arp32 *module;
@@ -711,6 +1305,8 @@ struct Arp32Display : TransparentWidget {
 
 		Vec pos = Vec(3,14);
 
+		Arp32::DisplayState state = module->display.read();
+
 		std::shared_ptr<Font> font = APP->window->loadFont(fontPath);
 
 		if (font) {		
@@ -721,31 +1317,47 @@ struct Arp32Display : TransparentWidget {
 
 			nvgFillColor(ctx.vg, nvgRGBA(0x00, 0xFF, 0xFF, 0xFF));
 		
+			// Keep the pattern in range of the names and sources, whatever was published
+			int pattern = std::min(std::max(state.pattern, 0), (state.custom ? Arp32::MAX_PROGRAMS : 6) - 1);
+
 			char text[128];
-			if (module->inputLen == 0) {
+			if (state.length == 0) {
 				snprintf(text, sizeof(text), "Error: inputLen == 0");
+			} else if (state.custom) {
+				const char *units[3] = {"st", "M", "m"};
+				snprintf(text, sizeof(text), "Custom %d (%d%s, %d)", 
+					pattern + 1,
+					state.size,
+					units[std::min(std::max(state.scale, 0), 2)],
+					state.offset);
+
+				// The source belongs to the UI thread, like this widget
+				const std::string &source = module->programSources[pattern];
+				nvgFontSize(ctx.vg, 11);
+				nvgText(ctx.vg, pos.x, pos.y + 14, source.empty() ? "(empty)" : source.c_str(), NULL);
+				nvgFontSize(ctx.vg, 14.5);
 			} else {
-				switch(module->inputScale) {
+				switch(state.scale) {
 					case 0: 
 						snprintf(text, sizeof(text), "%s (%d, %dst, %d)", 
-							module->nextPattern.c_str(),
-							module->inputLen,
-							module->inputSize,
-							module->offset);
+							ARP32_NAMES[pattern],
+							state.length,
+							state.size,
+							state.offset);
 						break;
 					case 1: 
 						snprintf(text, sizeof(text), "%s (%d, %dM, %d)", 
-							module->nextPattern.c_str(),
-							module->inputLen,
-							module->inputSize,
-							module->offset);
+							ARP32_NAMES[pattern],
+							state.length,
+							state.size,
+							state.offset);
 						break;
 					case 2: 
 						snprintf(text, sizeof(text), "%s (%d, %dm, %d)", 
-							module->nextPattern.c_str(),
-							module->inputLen,
-							module->inputSize,
-							module->offset);
+							ARP32_NAMES[pattern],
+							state.length,
+							state.size,
+							state.offset);
 						break;
 					default: snprintf(text, sizeof(text), "Error..."); break;
 				}
@@ -850,6 +1462,128 @@ struct Arp32Widget : ModuleWidget {
 			}
 		};
 
+		struct SwitchModeItem : Arp32Menu {
+			digital::PatternSwitch::Mode mode;
+			int bars;
+			void onAction(const rack::widget::Widget::ActionEvent &e) override {
+				module->patternSwitch.mode = mode;
+				module->patternSwitch.bars = bars;
+			}
+		};
+
+		struct SwitchModeMenu : Arp32Menu {
+			Menu *createChildMenu() override {
+				Menu *menu = new Menu;
+				std::vector<digital::PatternSwitch::Mode> modes = {digital::PatternSwitch::IMMEDIATE, digital::PatternSwitch::AT_EOC, 
+					digital::PatternSwitch::AT_BARS, digital::PatternSwitch::AT_BARS, digital::PatternSwitch::AT_BARS};
+				std::vector<int> bars = {1, 1, 1, 2, 4};
+				std::vector<std::string> names = {"Immediately", "At end of cycle", "Every bar", "Every 2 bars", "Every 4 bars"};
+				for (size_t i = 0; i < modes.size(); i++) {
+					bool checked = module->patternSwitch.mode == modes[i] && (modes[i] != digital::PatternSwitch::AT_BARS || module->patternSwitch.bars == bars[i]);
+					SwitchModeItem *item = createMenuItem<SwitchModeItem>(names[i], CHECKMARK(checked));
+					item->module = module;
+					item->mode = modes[i];
+					item->bars = bars[i];
+					menu->addChild(item);
+				}
+				return menu;
+			}
+		};
+
+		struct RatchetItem : Arp32Menu {
+			int ratchets;
+			void onAction(const rack::widget::Widget::ActionEvent &e) override {
+				module->scheduler.ratchets = ratchets;
+			}
+		};
+
+		struct RatchetMenu : Arp32Menu {
+			Menu *createChildMenu() override {
+				Menu *menu = new Menu;
+				std::vector<int> counts = {1, 2, 3, 4, 6, 8};
+				for (size_t i = 0; i < counts.size(); i++) {
+					std::string name = counts[i] == 1 ? "Off" : std::to_string(counts[i]) + " per step";
+					RatchetItem *item = createMenuItem<RatchetItem>(name, CHECKMARK(module->scheduler.ratchets == counts[i]));
+					item->module = module;
+					item->ratchets = counts[i];
+					menu->addChild(item);
+				}
+				return menu;
+			}
+		};
+
+		struct SwingItem : Arp32Menu {
+			int swing;
+			void onAction(const rack::widget::Widget::ActionEvent &e) override {
+				module->scheduler.swing = swing;
+			}
+		};
+
+		struct SwingMenu : Arp32Menu {
+			Menu *createChildMenu() override {
+				Menu *menu = new Menu;
+				std::vector<int> amounts = {50, 54, 58, 62, 66, 71, 75};
+				for (size_t i = 0; i < amounts.size(); i++) {
+					std::string name = amounts[i] == 50 ? "Off" : std::to_string(amounts[i]) + "%";
+					SwingItem *item = createMenuItem<SwingItem>(name, CHECKMARK(module->scheduler.swing == amounts[i]));
+					item->module = module;
+					item->swing = amounts[i];
+					menu->addChild(item);
+				}
+				return menu;
+			}
+		};
+
+		struct CustomPatternsItem : Arp32Menu {
+			void onAction(const rack::widget::Widget::ActionEvent &e) override {
+				module->customPatterns ^= true;
+			}
+		};
+
+		struct ProgramField : ui::TextField {
+			Arp32 *module;
+			int slot;
+			void onChange(const ChangeEvent &e) override {
+				module->setProgram(slot, getText());
+			}
+		};
+
+		struct CustomPatternsMenu : Arp32Menu {
+			Menu *createChildMenu() override {
+				Menu *menu = new Menu;
+
+				CustomPatternsItem *item = createMenuItem<CustomPatternsItem>("Play custom patterns", CHECKMARK(module->customPatterns));
+				item->module = module;
+				menu->addChild(item);
+
+				// Show the slots in use and a spare one, at least as many as the knob reaches
+				int nSlots = 6;
+				for (int i = 0; i < Arp32::MAX_PROGRAMS; i++) {
+					if (!module->programSources[i].empty()) {
+						nSlots = std::max(nSlots, std::min(i + 2, (int)Arp32::MAX_PROGRAMS));
+					}
+				}
+
+				for (int i = 0; i < nSlots; i++) {
+					std::string label = "Pattern " + std::to_string(i + 1);
+					if (!module->programErrors[i].empty()) {
+						label += ": " + module->programErrors[i];
+					}
+					menu->addChild(createMenuLabel(label));
+
+					ProgramField *field = new ProgramField;
+					field->module = module;
+					field->slot = i;
+					field->box.size.x = 250;
+					field->placeholder = "e.g. 0 [+2 +1]3 < 7 . | 5 4 >";
+					field->setText(module->programSources[i]);
+					menu->addChild(field);
+				}
+
+				return menu;
+			}
+		};
+
 		menu->addChild(construct<MenuLabel>());
 
 		GateModeMenu *item = createMenuItem<GateModeMenu>("Gate Mode");
@@ -862,6 +1596,33 @@ struct Arp32Widget : ModuleWidget {
 		ritem->parent = this;
 		menu->addChild(ritem);
 
+		SwitchModeMenu *sitem = createMenuItem<SwitchModeMenu>("Switch to a changed pattern");
+		sitem->module = arp;
+		sitem->parent = this;
+		menu->addChild(sitem);
+
+		RatchetMenu *rtitem = createMenuItem<RatchetMenu>("Ratchets");
+		rtitem->module = arp;
+		rtitem->parent = this;
+		menu->addChild(rtitem);
+
+		SwingMenu *switem2 = createMenuItem<SwingMenu>("Swing");
+		switem2->module = arp;
+		switem2->parent = this;
+		menu->addChild(switem2);
+
+		CustomPatternsMenu *citem = createMenuItem<CustomPatternsMenu>("Custom patterns");
+		citem->module = arp;
+		citem->parent = this;
+		menu->addChild(citem);
+
+#ifndef METAMODULE
+		menu->addChild(construct<MenuLabel>());
+		gui::TraceItem *titem = createMenuItem<gui::TraceItem>("Debug trace to file", CHECKMARK(arp->debugFlag));
+		titem->module = arp;
+		menu->addChild(titem);
+#endif
+
 	}
 
 };
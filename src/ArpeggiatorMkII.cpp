@@ -5,403 +5,172 @@
 
 using namespace ah;
 
-struct Pattern {
-
-	unsigned int length = 0;
-	int trans = 0;
-	unsigned int scale = 0;
-	unsigned int count = 0;
-
-	unsigned int MAJOR[7] = {0,2,4,5,7,9,11};
-	unsigned int MINOR[7] = {0,2,3,5,7,8,10};
-
-	virtual std::string getName() = 0;
-
-	virtual void initialise(unsigned int l, unsigned int sc, int tr, bool freeRun) {
-		length = l;
-		trans = tr;
-		scale = sc;
-		count = 0;
-	};
-
-	virtual void advance() {
-		count++;
-	};
-
-	virtual int getOffset() = 0;
-
-	virtual bool isPatternFinished() = 0;
-
-	int getMajor(int count) {
-		int i = abs(count);
-		int sign = (count < 0) ? -1 : (count > 0);
-		return sign * ((i / 7) * 12 + MAJOR[i % 7]);
-	}
-
-	int getMinor(int count) {
-		int i = abs(count);
-		int sign = (count < 0) ? -1 : (count > 0);
-		return sign * ((i / 7) * 12 + MINOR[i % 7]);
-	}
-
+static const char *const ARPEGGIATOR2_PATTERN_NAMES[6] = {"Up", "Down", "UpDown", "DownUp", "Rez", "On The Run"};
+static const char *const ARPEGGIATOR2_ARP_NAMES[4] = {"Right", "Left", "RightLeft", "LeftRight"};
+
+static const char *const ARPEGGIATOR2_TRACE_NAMES[] = {
+	"No pitch input, aborting",
+	"Triggered",
+	"Toggling lock: locked",
+	"Countdown new sequence: samples",
+	"Countdown new cycle: samples",
+	"Clocked",
+	"Start countdown: clock active",
+	"Short sequence",
+	"Free running sequence; starting",
+	"Triggered sequence; wait for trigger",
+	"TRIG input re-connected",
+	"Finished cycle",
+	"Finished sequence: running",
+	"Flagging new cycle",
+	"New sequence: pattern, length, locked",
+	"No inputs, assume single 0V pitch",
+	"New cycle: pitches, arpeggio",
+	"Advance cycle: index, pitch, offset",
+	"Step: V"
 };
 
-struct UpPattern : Pattern {
-
-	std::string getName() override {
-		return "Up";
-	};
+static const int ARPEGGIATOR2_MAJOR[7] = {0,2,4,5,7,9,11};
+static const int ARPEGGIATOR2_MINOR[7] = {0,2,3,5,7,8,10};
 
-	void initialise(unsigned int l, unsigned int sc, int tr, bool fr) override {
-		Pattern::initialise(l,sc,tr,fr);
+static int arpeggiator2Interval(int count, unsigned int scale) {
+	int i = abs(count);
+	int sign = (count < 0) ? -1 : (count > 0);
+	switch(scale) {
+		case 1: return sign * ((i / 7) * 12 + ARPEGGIATOR2_MAJOR[i % 7]);
+		case 2: return sign * ((i / 7) * 12 + ARPEGGIATOR2_MINOR[i % 7]);
+		default:
+			return count;
 	}
+}
 
-	int getOffset() override {
-
-		switch(scale) {
-			case 0: return count * trans; break;
-			case 1: return getMajor(count * trans); break;
-			case 2: return getMinor(count * trans); break;
-			default:
-				return count * trans; break;
-		}
-
-	}
-
-	bool isPatternFinished() override {
-		return(count == length);
-	}
-
-};
-
-struct DownPattern : Pattern {
+// Note order for each arpeggio over 1-16 pitches, free-running or not, built once when the first module is created.
+// Stepping an arpeggio is then an index into a row of the table
+struct ArpStepTable {
 
-	int currSt = 0;
+	const static int NUM_ARPS = 4;
+	const static int MAX_PITCHES = 16;
+	const static int MAX_STEPS = 2 * MAX_PITCHES;
 
-	std::string getName() override {
-		return "Down";
+	struct Steps {
+		unsigned char index[MAX_STEPS];
+		unsigned int length;
 	};
 
-	void initialise(unsigned int l, unsigned int sc, int tr, bool fr) override {
-		Pattern::initialise(l,sc,tr,fr);
-		currSt = length - 1;
-	}
-
-	void advance() override {
-		Pattern::advance();
-		currSt--;
-	}
-
-	int getOffset() override {
-		switch(scale) {
-			case 0: return currSt * trans; break;
-			case 1: return getMajor(currSt * trans); break;
-			case 2: return getMinor(currSt * trans); break;
-			default:
-				return currSt * trans; break;
-		}
-	}
-
-	bool isPatternFinished() override {
-		return (currSt < 0);
-	}
-
-};
-
-struct UpDownPattern : Pattern {
-
-	unsigned int mag = 0;
-	unsigned int end = 0;
-
-	std::string getName() override {
-		return "UpDown";
-	};	
-
-	void initialise(unsigned int l, unsigned int sc, int tr, bool fr) override {
-		Pattern::initialise(l,sc,tr,fr);
-		mag = l - 1;
-		if (fr) {
-			end = 2 * l - 2;
-		} else {
-			end = 2 * l - 1;
-		}
-		if (end < 1) {
-			end = 1;
-		}
-	}
-
-	int getOffset() override {
-		
-		int note = (mag - abs(static_cast<int>(mag - count)));
-		
-		switch(scale) {
-			case 0: return note * trans; break;
-			case 1: return getMajor(note * trans); break;
-			case 2: return getMinor(note * trans); break;
-			default:
-				return note * trans; break;
-		}
-
-	}
-
-	bool isPatternFinished() override {
-		return(count == end);
-	}
-
-};
-
-struct DownUpPattern : Pattern {
-
-	unsigned int mag = 0;
-	unsigned int end = 0;
-	
-	std::string getName() override {
-		return "DownUp";
-	};	
-
-	void initialise(unsigned int l, unsigned int sc, int tr, bool fr) override {
-		Pattern::initialise(l,sc,tr,fr);
-		mag = l - 1;
-		if (fr) {
-			end = 2 * l - 2;
-		} else {
-			end = 2 * l - 1;
-		}
-		if (end < 1) {
-			end = 1;
-		}
-	}
-
-	int getOffset() override {
-
-		int note = -(mag - abs(static_cast<int>(mag - count)));
-
-		switch(scale) {
-			case 0: return note * trans; break;
-			case 1: return getMajor(note * trans); break;
-			case 2: return getMinor(note * trans); break;
-			default:
-				return note * trans; break;
+	Steps steps[NUM_ARPS][MAX_PITCHES][2];
+
+	ArpStepTable() {
+		for (int a = 0; a < NUM_ARPS; a++) {
+			for (int n = 1; n <= MAX_PITCHES; n++) {
+				for (int fr = 0; fr < 2; fr++) {
+
+					Steps &row = steps[a][n - 1][fr];
+					int mag = n - 1;
+					int end = fr ? 2 * n - 2 : 2 * n - 1;
+					if (end < 1) {
+						end = 1;
+					}
+
+					switch(a) {
+						case 1: // Left
+							row.length = n;
+							for (int i = 0; i < n; i++) row.index[i] = n - 1 - i;
+							break;
+						case 2: // RightLeft
+							row.length = end;
+							for (int i = 0; i < end; i++) row.index[i] = mag - abs(mag - i);
+							break;
+						case 3: // LeftRight
+							row.length = end;
+							for (int i = 0; i < end; i++) row.index[i] = abs(mag - i);
+							break;
+						default: // Right
+							row.length = n;
+							for (int i = 0; i < n; i++) row.index[i] = i;
+							break;
+					}
+				}
+			}
 		}
-
-	}
-
-	bool isPatternFinished() override {
-		return(count == end);
-	}
-
-};
-
-struct NotePattern : Pattern {
-
-	std::vector<int> notes;
-
-	void initialise(unsigned int l, unsigned int sc, int tr, bool fr) override {
-		Pattern::initialise(l,sc,tr,fr);
-	}
-
-	int getOffset() override {
-		return getNote(count);
 	}
 
-	bool isPatternFinished() override {
-		return (count == static_cast<unsigned int>(notes.size()));
+	const Steps &get(unsigned int arp, unsigned int nPitches, bool freeRun) {
+		arp = std::min(arp, (unsigned int)(NUM_ARPS - 1));
+		nPitches = std::max(1u, std::min(nPitches, (unsigned int)MAX_PITCHES));
+		return steps[arp][nPitches - 1][freeRun ? 1 : 0];
 	}
 
-	int getNote(int i) {
-		return notes[i];
+	static ArpStepTable &instance() {
+		static ArpStepTable table;
+		return table;
 	}
 
 };
 
-struct RezPattern : NotePattern {
-	
-	std::string getName() override {
-		return "Rez";
-	};	
-
-	RezPattern() {
-		notes.clear();
-		notes.push_back(0);
-		notes.push_back(12);
-		notes.push_back(0);
-		notes.push_back(0);
-		notes.push_back(8);
-		notes.push_back(0);
-		notes.push_back(0);
-		notes.push_back(3);
-		notes.push_back(0);
-		notes.push_back(0);
-		notes.push_back(3);
-		notes.push_back(0);
-		notes.push_back(3);
-		notes.push_back(0);
-		notes.push_back(8);
-		notes.push_back(0);
-	}
+// Semitone offsets for one run through a pattern, filled in at the start of each sequence
+struct PatternSteps {
 
-};
+	const static int MAX_STEPS = 32;
 
-struct OnTheRunPattern : NotePattern {
-
-	std::string getName() override {
-		return "On The Run";
-	};	
-
-	OnTheRunPattern() {
-		notes.clear();
-		notes.push_back(0);
-		notes.push_back(4);
-		notes.push_back(6);
-		notes.push_back(4);
-		notes.push_back(9);
-		notes.push_back(11);
-		notes.push_back(13);
-		notes.push_back(11);
-	}
-
-};
-
-struct Arpeggio {
-
-	virtual std::string getName() = 0;
-
-	virtual void initialise(unsigned int nPitches, bool fr) = 0;
-
-	virtual void advance() = 0;
-
-	virtual unsigned int getPitch() = 0;
-
-	virtual bool isArpeggioFinished() = 0;
-
-};
-
-struct RightArp : Arpeggio {
-
-	unsigned int index = 0;
-	unsigned int nPitches = 0;
-
-	std::string getName() override {
-		return "Right";
-	};
-
-	void initialise(unsigned int np, bool fr) override {
-		index = 0;
-		nPitches = np;
-	}
-
-	void advance() override {
-		index++;
-	}
-
-	unsigned int getPitch() override {
-		return index;
-	}
-
-	bool isArpeggioFinished() override {
-		return (index == nPitches);
-	}
-
-};
-
-struct LeftArp : Arpeggio {
-
-	int index = 0;
-	unsigned int nPitches = 0;
-
-	std::string getName() override {
-		return "Left";
-	};
-
-	void initialise(unsigned int np, bool fr) override {
-		nPitches = np;
-		index = nPitches - 1;
-	}
-
-	void advance() override {
-		index--;
-	}
+	int offset[MAX_STEPS];
+	unsigned int length = 0;
 
-	unsigned int getPitch() override {
-		return index;
-	}
+	// What the steps were built from
+	unsigned int builtPattern = 0;
+	unsigned int builtLength = 0;
+	unsigned int builtScale = 0;
+	int builtTrans = 0;
+	bool builtFreeRun = false;
 
-	bool isArpeggioFinished() override {
-		return (index < 0);
+	bool matches(unsigned int pattern, unsigned int len, unsigned int scale, int trans, bool freeRun) {
+		return length > 0 && pattern == builtPattern && len == builtLength && scale == builtScale && 
+			trans == builtTrans && freeRun == builtFreeRun;
 	}
 
-};
+	void build(unsigned int pattern, unsigned int len, unsigned int scale, int trans, bool freeRun) {
 
-struct RightLeftArp : Arpeggio {
+		builtPattern = pattern;
+		builtLength = len;
+		builtScale = scale;
+		builtTrans = trans;
+		builtFreeRun = freeRun;
 
-	unsigned int currSt = 0;
-	unsigned int mag = 0;
-	unsigned int end = 0;
+		static const int REZ[16] = {0, 12, 0, 0, 8, 0, 0, 3, 0, 0, 3, 0, 3, 0, 8, 0};
+		static const int ONTHERUN[8] = {0, 4, 6, 4, 9, 11, 13, 11};
 
-	std::string getName() override {
-		return "RightLeft";
-	};	
-
-	void initialise(unsigned int l, bool fr) override {
-		mag = l - 1;
-		if (fr) {
-			end = 2 * l - 2;
-		} else {
-			end = 2 * l - 1;
-		}
+		int mag = len - 1;
+		int end = freeRun ? 2 * len - 2 : 2 * len - 1;
 		if (end < 1) {
 			end = 1;
 		}
-		currSt = 0;
-	}
-
-	void advance() override {
-		currSt++;
-	}
-
-	unsigned int getPitch() override {
-		return mag - abs(static_cast<int>(mag - currSt));
-	}
-
-	bool isArpeggioFinished() override {
-		return(currSt == end);
-	}
-
-};
-
-struct LeftRightArp : Arpeggio {
-
-	unsigned int currSt = 0;
-	unsigned int mag = 0;
-	unsigned int end = 0;
 
-	std::string getName() override {
-		return "LeftRight";
-	};
-
-	void initialise(unsigned int l, bool fr) override {
-		mag = l - 1;
-		if (fr) {
-			end = 2 * l - 2;
-		} else {
-			end = 2 * l - 1;
+		switch(pattern) {
+			case 1: // Down
+				length = len;
+				for (unsigned int i = 0; i < length; i++) offset[i] = arpeggiator2Interval((len - 1 - i) * trans, scale);
+				break;
+			case 2: // UpDown
+				length = end;
+				for (unsigned int i = 0; i < length; i++) offset[i] = arpeggiator2Interval((mag - abs(mag - (int)i)) * trans, scale);
+				break;
+			case 3: // DownUp
+				length = end;
+				for (unsigned int i = 0; i < length; i++) offset[i] = arpeggiator2Interval(-(mag - abs(mag - (int)i)) * trans, scale);
+				break;
+			case 4: // Rez
+				length = 16;
+				for (unsigned int i = 0; i < length; i++) offset[i] = REZ[i];
+				break;
+			case 5: // On The Run
+				length = 8;
+				for (unsigned int i = 0; i < length; i++) offset[i] = ONTHERUN[i];
+				break;
+			default: // Up
+				length = len;
+				for (unsigned int i = 0; i < length; i++) offset[i] = arpeggiator2Interval(i * trans, scale);
+				break;
 		}
-		if (end < 1) {
-			end = 1;
-		}
-		currSt = 0;
-	}
-
-	void advance() override {
-		currSt++;
-	}
 
-	unsigned int getPitch() override {
-		return abs(static_cast<int>(mag - currSt));
-	}
-
-	bool isArpeggioFinished() override {
-		return(currSt == end);
 	}
 
 };
@@ -411,6 +180,7 @@ struct Arpeggiator2 : core::AHModule {
 	const static unsigned int MAX_STEPS = 16;
 	const static unsigned int MAX_DIST = 12; //Octave
 	const static unsigned int NUM_PITCHES = 6;
+	const static unsigned int MAX_PITCHES = ArpStepTable::MAX_PITCHES;
 
 	enum ParamIds {
 		LOCK_PARAM,
@@ -444,6 +214,29 @@ struct Arpeggiator2 : core::AHModule {
 		NUM_LIGHTS
 	};
 
+	enum TraceIds {
+		TRACE_NO_INPUT,
+		TRACE_TRIGGERED,
+		TRACE_LOCK,
+		TRACE_COUNTDOWN_SEQUENCE,
+		TRACE_COUNTDOWN_CYCLE,
+		TRACE_CLOCKED,
+		TRACE_START_COUNTDOWN,
+		TRACE_SHORT_SEQUENCE,
+		TRACE_FREE_RUNNING,
+		TRACE_WAIT_TRIGGER,
+		TRACE_TRIG_RECONNECTED,
+		TRACE_FINISHED_CYCLE,
+		TRACE_FINISHED_SEQUENCE,
+		TRACE_FLAG_CYCLE,
+		TRACE_NEW_SEQUENCE,
+		TRACE_NO_PITCHES,
+		TRACE_NEW_CYCLE,
+		TRACE_ADVANCE,
+		TRACE_STEP,
+		NUM_TRACES
+	};
+
 	Arpeggiator2() : core::AHModule(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS) {
 
 		configParam(LOCK_PARAM, 0.0, 1.0, 0.0, "Input lock");
@@ -463,15 +256,23 @@ struct Arpeggiator2 : core::AHModule {
 
 		configParam(LENGTH_PARAM, 1.0, 16.0, 1.0); 
 
+		for (unsigned int p = 0; p < NUM_PITCHES; p++) {
+			configInput(PITCH_INPUT + p, "1V/oct pitch " + std::to_string(p + 1) + " (Poly)");
+		}
+
+		arpTable = &ArpStepTable::instance();
+		arpSteps = &arpTable->get(0, 1, false);
+
 		onReset();
-		id = rand();
-		debugFlag = false;
+		setTraceNames(ARPEGGIATOR2_TRACE_NAMES, NUM_TRACES);
 
 	}
 
 	void process(const ProcessArgs &args) override;
 
 	void onReset() override {
+		patternSwitch.reset();
+		scheduler.reset();
 		newSequence = 0;
 		newCycle = 0;
 		isRunning = false;
@@ -485,6 +286,22 @@ struct Arpeggiator2 : core::AHModule {
 		json_t *gateModeJ = json_integer((int) gateMode);
 		json_object_set_new(rootJ, "gateMode", gateModeJ);
 
+		// switchMode
+		json_t *switchModeJ = json_integer((int) patternSwitch.mode);
+		json_object_set_new(rootJ, "switchMode", switchModeJ);
+
+		// switchBars
+		json_t *switchBarsJ = json_integer(patternSwitch.bars);
+		json_object_set_new(rootJ, "switchBars", switchBarsJ);
+
+		// ratchets
+		json_t *ratchetsJ = json_integer(scheduler.ratchets);
+		json_object_set_new(rootJ, "ratchets", ratchetsJ);
+
+		// swing
+		json_t *swingJ = json_integer(scheduler.swing);
+		json_object_set_new(rootJ, "swing", swingJ);
+
 		return rootJ;
 	}
 
@@ -495,6 +312,30 @@ struct Arpeggiator2 : core::AHModule {
 		if (gateModeJ) {
 			gateMode = (GateMode)json_integer_value(gateModeJ);
 		}
+
+		// switchMode
+		json_t *switchModeJ = json_object_get(rootJ, "switchMode");
+		if (switchModeJ) {
+			patternSwitch.mode = (digital::PatternSwitch::Mode)json_integer_value(switchModeJ);
+		}
+
+		// switchBars
+		json_t *switchBarsJ = json_object_get(rootJ, "switchBars");
+		if (switchBarsJ) {
+			patternSwitch.bars = std::max((int)json_integer_value(switchBarsJ), 1);
+		}
+
+		// ratchets
+		json_t *ratchetsJ = json_object_get(rootJ, "ratchets");
+		if (ratchetsJ) {
+			scheduler.ratchets = clamp((int)json_integer_value(ratchetsJ), 1, 8);
+		}
+
+		// swing
+		json_t *swingJ = json_object_get(rootJ, "swing");
+		if (swingJ) {
+			scheduler.swing = clamp((int)json_integer_value(swingJ), 50, 75);
+		}
 	}
 
 	enum GateMode {
@@ -517,6 +358,7 @@ struct Arpeggiator2 : core::AHModule {
 	bool locked = false;
 
 	float outVolts = 0;
+	float stepVolts = 0;
 	bool isRunning = false;
 	bool freeRunning = false;
 	int error = 0;
@@ -540,39 +382,53 @@ struct Arpeggiator2 : core::AHModule {
 	float trans = 0;
 	unsigned int scale = 0;
 
-	UpPattern		patt_up; 
-	DownPattern		patt_down; 
-	UpDownPattern	patt_updown;
-	DownUpPattern	patt_downup;
-	RezPattern		patt_rez;
-	OnTheRunPattern	patt_ontherun;
-
-	UpPattern		ui_patt_up; 
-	DownPattern		ui_patt_down; 
-	UpDownPattern	ui_patt_updown;
-	DownUpPattern	ui_patt_downup;
-	RezPattern		ui_patt_rez;
-	OnTheRunPattern	ui_patt_ontherun;
-
-	RightArp		arp_right;
-	LeftArp			arp_left;
-	RightLeftArp	arp_rightleft;
-	LeftRightArp	arp_leftright;
-
-	RightArp		ui_arp_right;
-	LeftArp			ui_arp_left;
-	RightLeftArp	ui_arp_rightleft;
-	LeftRightArp	ui_arp_leftright;
-
-	Pattern *currPatt = &patt_up;
-	Arpeggio *currArp = &arp_right;
-
-	Pattern *uiPatt = &ui_patt_up;
-	Arpeggio *uiArp = &arp_right;
-
-	float pitches[6];
+	// The pattern playing and the next one, rebuilt between clocks whenever the inputs change
+	PatternSteps pattBuffers[2];
+	PatternSteps *pattSteps = &pattBuffers[0];
+	PatternSteps *nextPattSteps = &pattBuffers[1];
+	unsigned int pattStep = 0;
+	digital::PatternSwitch patternSwitch;
+	digital::StepScheduler scheduler;
+
+	// Move onto the next pattern, building it now if it was not prepared from these settings
+	void swapPattern(unsigned int pat, unsigned int len, unsigned int sc, int tr, bool fr) {
+		if (!nextPattSteps->matches(pat, len, sc, tr, fr)) {
+			nextPattSteps->build(pat, len, sc, tr, fr);
+		}
+		std::swap(pattSteps, nextPattSteps);
+	}
+
+	ArpStepTable *arpTable = NULL;
+	const ArpStepTable::Steps *arpSteps = NULL;
+	unsigned int arpStep = 0;
+
+	float pitches[MAX_PITCHES];
 	unsigned int nPitches = 0;
-	int id = 0;
+
+	// State shown on the panel, published for the widget
+	struct DisplayState {
+		int pattern;
+		int arp;
+		int length;
+		int trans;
+		int scale;
+		int index;
+		float pitch;
+	};
+
+	core::DisplaySnapshot<DisplayState> display;
+
+	void publishDisplay() {
+		DisplayState state;
+		state.pattern = inputPat;
+		state.arp = inputArp;
+		state.length = inputLen;
+		state.trans = inputTrans;
+		state.scale = inputScale;
+		state.index = arpSteps->index[std::min(arpStep, arpSteps->length - 1)];
+		state.pitch = outVolts;
+		display.publish(state);
+	}
 
 };
 
@@ -622,42 +478,17 @@ void Arpeggiator2::process(const ProcessArgs &args) {
 
 	// Process inputs
 	bool clockStatus	= clockTrigger.process(clockInput);
+	if (clockStatus) {
+		scheduler.clock();
+	}
 	bool triggerStatus	= trigTrigger.process(trigInput);
 	bool lockStatus		= lockTrigger.process(lockInput);
 	bool buttonStatus	= buttonTrigger.process(buttonInput);
 
-	// Read input pitches and assign to pitch array
-	unsigned int nValidPitches = 0;
-	float inputPitches[NUM_PITCHES];
-	for (unsigned int p = 0; p < NUM_PITCHES; p++) {
-		unsigned int index = PITCH_INPUT + p;
-		if (inputs[index].isConnected()) {
-			inputPitches[nValidPitches] = inputs[index].getVoltage();
-			nValidPitches++;
-		} else {
-			inputPitches[nValidPitches] = 0.0;
-		}
-	}
-
-	// if (debugEnabled()) {
-	// 	for (int p = 0; p < nValidPitches; p++) {
-	// 		std::cout << inputPitches[p] << std::endl;
-	// 	}
-	// }
-
-	// Always play something
-	if (nValidPitches == 0) {
-		#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " " << id  << " No inputs, assume single 0V pitch" << std::endl; }
-#endif
-		nValidPitches = 1;
-	}
-
 	// Need to understand why this happens
 	if (inputLen == 0) {
-		#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " " << id  << " InputLen == 0, aborting" << std::endl; }
-#endif
+		if (debugEnabled(5000)) { trace(TRACE_NO_INPUT); }
+		publishDisplay();
 		return; // No inputs, no music
 	}
 
@@ -669,41 +500,31 @@ if (debugEnabled()) { std::cout << stepX << " " << id  << " InputLen == 0, abort
 	// Has the trigger input been fired
 	if (triggerStatus) {
 		triggerPulse.trigger(5e-5);
-		#ifndef METAMODULE
-		if (debugEnabled()) { std::cout << stepX << " " << id  << " Triggered" << std::endl; }
-		#endif
+		trace(TRACE_TRIGGERED);
 	}
 
 	// Update the trigger pulse and determine if it is still high
 	bool triggerHigh = triggerPulse.process(args.sampleTime);
-	if (debugEnabled()) {
-		#ifndef METAMODULE
-		if (triggerHigh) {
-			std::cout << stepX << " " << id  << " Trigger is high" << std::endl;
-		}
-		#endif
-	}
 
 	// Update lock
 	if (lockStatus) {
-		#ifndef METAMODULE
-		if (debugEnabled()) { std::cout << "Toggling lock: " << locked << std::endl; }
-		#endif
+		trace(TRACE_LOCK, !locked);
 		locked = !locked;
 	}
 
 	if (newSequence) {
 		newSequence--;
-		#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " " << id  << " Countdown newSequence: " << newSequence << std::endl; }
-#endif
+		trace(TRACE_COUNTDOWN_SEQUENCE, newSequence);
 	}
 
 	if (newCycle) {
 		newCycle--;
-		#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " " << id  << " Countdown newCycle: " << newCycle << std::endl; }
-#endif
+		trace(TRACE_COUNTDOWN_CYCLE, newCycle);
+	}
+
+	// Prepare the next pattern away from the clock edges
+	if (controlDue && !clockStatus && !locked && !nextPattSteps->matches(inputPat, inputLen, inputScale, inputTrans, freeRunning)) {
+		nextPattSteps->build(inputPat, inputLen, inputScale, inputTrans, freeRunning);
 	}
 
 	// OK so the problem here might be that the clock gate is still high right after the trigger gate fired on the previous step
@@ -711,17 +532,13 @@ if (debugEnabled()) { std::cout << stepX << " " << id  << " Countdown newCycle:
 	// Has the clock input been fired
 	bool isClocked = false;
 	if (clockStatus && !triggerHigh) {
-		#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " " << id  << " Clocked" << std::endl; }
-#endif
+		trace(TRACE_CLOCKED);
 		isClocked = true;
 	}
 
 	// Has the trigger input been fired, either on the input or button
 	if (triggerStatus || buttonStatus) {
-		#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " " << id  << " Start countdown " << clockActive <<std::endl; }
-#endif
+		trace(TRACE_START_COUNTDOWN, clockActive);
 		if (clockActive) {
 			newSequence = COUNTDOWN;
 			newCycle = COUNTDOWN;
@@ -729,53 +546,54 @@ if (debugEnabled()) { std::cout << stepX << " " << id  << " Start countdown " <<
 	}
 
 	// Received trigger before EOS, fire EOS gate anyway
-	if (triggerStatus && isRunning && !currPatt->isPatternFinished()) {
+	if (triggerStatus && isRunning && pattStep < pattSteps->length) {
 			// Pulse the EOS gate
 		eosPulse.trigger(digital::TRIGGER);
-		#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " " << id  << " Short sequence" << std::endl; }
-#endif
+		trace(TRACE_SHORT_SEQUENCE);
 	}
 
 	// So this is where the free-running could be triggered
 	if (isClocked && !isRunning) { // Must have a clock and not be already running
 		if (!trigActive) { // If nothing plugged into the TRIG input
-			#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " " << id  << " Free running sequence; starting" << std::endl; }
-#endif
+			trace(TRACE_FREE_RUNNING);
 			freeRunning = true; // We're free-running
 			newSequence = COUNTDOWN;
 			newCycle = LAUNCH;
 		} else {
-			#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " " << id  << " Triggered sequence; wait for trigger" << std::endl; }
-#endif
+			trace(TRACE_WAIT_TRIGGER);
 			freeRunning = false;
 		}
 	}
 
 	// Detect cable being plugged in when free-running, stop free-running
 	if (freeRunning && trigActive && isRunning) {
-		#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " " << id  << " TRIG input re-connected" << std::endl; }
-#endif
+		trace(TRACE_TRIG_RECONNECTED);
 		freeRunning = false;
 	}	
 
+	// Take up a changed pattern straight away or at the bar, keeping our place in the sequence
+	if (isClocked && patternSwitch.clock() && isRunning && !locked && 
+		!pattSteps->matches(inputPat, inputLen, inputScale, inputTrans, freeRunning)) {
+		pattern = inputPat;
+		length = inputLen;
+		trans = inputTrans;
+		scale = inputScale;
+		swapPattern(pattern, length, scale, trans, freeRunning);
+		pattStep = std::min(pattStep, pattSteps->length - 1);
+	}
+
 	// Reached the end of the cycle
-	if (isRunning && isClocked && currArp->isArpeggioFinished()) {
+	if (isRunning && isClocked && arpStep >= arpSteps->length) {
 
 		// Completed 1 step
-		currPatt->advance();
+		pattStep++;
 
 		// Pulse the EOC gate
 		eocPulse.trigger(digital::TRIGGER);
-		#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " " << id  << " Finished Cycle" << std::endl; }
-#endif
+		trace(TRACE_FINISHED_CYCLE);
 
 		// Reached the end of the sequence
-		if (isRunning && currPatt->isPatternFinished()) {
+		if (isRunning && pattStep >= pattSteps->length) {
 
 			// Free running, so start new seqeuence & cycle
 			if (freeRunning) {
@@ -787,15 +605,11 @@ if (debugEnabled()) { std::cout << stepX << " " << id  << " Finished Cycle" << s
 	
 			// Pulse the EOS gate
 			eosPulse.trigger(digital::TRIGGER);
-			#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " " << id  << " Finished Sequence, flag: " << isRunning << std::endl; }
-#endif
+			trace(TRACE_FINISHED_SEQUENCE, isRunning);
 
 		} else {
 			newCycle = LAUNCH;
-			#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " " << id  << " Flagging new cycle" << std::endl; }
-#endif
+			trace(TRACE_FLAG_CYCLE);
 		}
 
 	}
@@ -811,26 +625,12 @@ if (debugEnabled()) { std::cout << stepX << " " << id  << " Flagging new cycle"
 			length = inputLen;
 			trans = inputTrans;
 			scale = inputScale;
-
-			switch(pattern) {
-				case 0:		currPatt = &patt_up; 		break;
-				case 1:		currPatt = &patt_down;		break;
-				case 2:		currPatt = &patt_updown;	break;
-				case 3:		currPatt = &patt_downup;	break;
-				case 4:		currPatt = &patt_rez;		break;
-				case 5:		currPatt = &patt_ontherun;	break;
-				default:	currPatt = &patt_up;		break;
-			};
-
 		}
 
-		#ifndef METAMODULE
-		if (debugEnabled()) { std::cout << stepX << " " << id  << " Initiatise new Sequence: Pattern: " << currPatt->getName() << 
-			" Length: " << inputLen <<
-			" Locked: " << locked << std::endl; }
-		#endif
+		trace(TRACE_NEW_SEQUENCE, pattern, inputLen, locked);
 
-		currPatt->initialise(length, scale, trans, freeRunning);
+		swapPattern(pattern, length, scale, trans, freeRunning);
+		pattStep = 0;
 
 		// We're running now
 		isRunning = true;
@@ -845,27 +645,31 @@ if (debugEnabled()) { std::cout << stepX << " " << id  << " Flagging new cycle"
 
 			arp = inputArp;
 
-			switch(arp) {
-				case 0: 	currArp = &arp_right;		break;
-				case 1: 	currArp = &arp_left;		break;
-				case 2: 	currArp = &arp_rightleft;	break;
-				case 3: 	currArp = &arp_leftright;	break;
-				default:	currArp = &arp_right;		break; 	
-			};
-
-			// Copy pitches
-			for (unsigned int p = 0; p < nValidPitches; p++) {
-				pitches[p] = inputPitches[p];
+			// Read input pitches, every channel of each connected input up to 16 notes
+			nPitches = 0;
+			for (unsigned int p = 0; p < NUM_PITCHES; p++) {
+				Input &input = inputs[PITCH_INPUT + p];
+				if (input.isConnected()) {
+					int channels = input.getChannels();
+					for (int c = 0; c < channels && nPitches < MAX_PITCHES; c++) {
+						pitches[nPitches++] = input.getVoltage(c);
+					}
+				}
+			}
+
+			// Always play something
+			if (nPitches == 0) {
+				trace(TRACE_NO_PITCHES);
+				pitches[0] = 0.0;
+				nPitches = 1;
 			}
-			nPitches = nValidPitches;
 
 		}
 
-		#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " " << id  << " Initiatise new Cycle: " << nPitches << " " << currArp->getName() << std::endl; }
-#endif
+		trace(TRACE_NEW_CYCLE, nPitches, arp);
 
-		currArp->initialise(nPitches, freeRunning);
+		arpSteps = &arpTable->get(arp, nPitches, freeRunning);
+		arpStep = 0;
 
 	}
 
@@ -874,56 +678,34 @@ if (debugEnabled()) { std::cout << stepX << " " << id  << " Initiatise new Cycle
 	// Only advance from the clock
 	if (isRunning && (isClocked || newCycle == LAUNCH)) {
 
-		#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " " << id  << " Advance Cycle: " << currArp->getPitch() << std::endl; }
-#endif
-
-		#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " " << id  << " Advance Cycle: " << pitches[currArp->getPitch()] << " " << (float)currPatt->getOffset() << std::endl; }
-#endif
+		trace(TRACE_ADVANCE, arpSteps->index[arpStep], pitches[arpSteps->index[arpStep]], pattSteps->offset[pattStep]);
 
 		// Finally set the out voltage
-		outVolts = clamp(pitches[currArp->getPitch()] + music::SEMITONE * (float)currPatt->getOffset(), -10.0f, 10.0f);
+		stepVolts = clamp(pitches[arpSteps->index[arpStep]] + music::SEMITONE * (float)pattSteps->offset[pattStep], -10.0f, 10.0f);
 
-		#ifndef METAMODULE
-		#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " " << id  << " Output V = " << outVolts << std::endl; }
-#endif
-		#endif
+		trace(TRACE_STEP, stepVolts);
 
 		// Update counters
-		currArp->advance();
+		arpStep++;
 
-		// Pulse the output gate
-		gatePulse.trigger(digital::TRIGGER);
+		// Pulse the output gate, or start the ratchets
+		scheduler.schedule();
 		
 	}
 
-	// Update UI
-	switch(inputPat) {
-		case 0:		uiPatt = &ui_patt_up; 		break;
-		case 1:		uiPatt = &ui_patt_down;		break;
-		case 2:		uiPatt = &ui_patt_updown;	break;
-		case 3:		uiPatt = &ui_patt_downup;	break;
-		case 4:		uiPatt = &ui_patt_rez;		break;
-		case 5:		uiPatt = &ui_patt_ontherun;	break;
-		default:	uiPatt = &ui_patt_up;		break;
-	};
-
-	uiPatt->initialise(inputLen, inputScale, inputTrans, freeRunning);
-
-	switch(inputArp) {
-		case 0: 	uiArp = &ui_arp_right;		break;
-		case 1: 	uiArp = &ui_arp_left;		break;
-		case 2: 	uiArp = &ui_arp_rightleft;	break;
-		case 3: 	uiArp = &ui_arp_leftright;	break;
-		default:	uiArp = &ui_arp_right;		break; 	
-	};
+	// Play the step, or its next ratchet
+	if (scheduler.process()) {
+		outVolts = stepVolts;
+		gatePulse.trigger(digital::TRIGGER);
+	}
 
-	uiArp->initialise(nPitches, freeRunning);
+	// Update UI
+	publishDisplay();
 
 	// Set the value
-	lights[LOCK_LIGHT].setBrightness(locked ? 1.0 : 0.0);
+	if (lightsDue) {
+		lights[LOCK_LIGHT].setBrightness(locked ? 1.0 : 0.0);
+	}
 	outputs[OUT_OUTPUT].setVoltage(outVolts);
 
 	bool gPulse = gatePulse.process(args.sampleTime);
@@ -961,6 +743,8 @@ struct Arpeggiator2Display : TransparentWidget {
 
 		Vec pos = Vec(0, 15);
 
+		Arpeggiator2::DisplayState state = module->display.read();
+
 		std::shared_ptr<Font> font = APP->window->loadFont(fontPath);
 
 		if (font) {		
@@ -971,25 +755,25 @@ struct Arpeggiator2Display : TransparentWidget {
 			nvgFillColor(ctx.vg, nvgRGBA(0x00, 0xFF, 0xFF, 0xFF));
 
 			char text[128];
-			if (module->inputLen == 0) {
+			if (state.length == 0) {
 				snprintf(text, sizeof(text), "Error: inputLen == 0");
 				nvgText(ctx.vg, pos.x + 10, pos.y + 5, text, NULL);			
 			} else {
-				snprintf(text, sizeof(text), "Pattern: %s", module->uiPatt->getName().c_str());
+				snprintf(text, sizeof(text), "Pattern: %s", ARPEGGIATOR2_PATTERN_NAMES[state.pattern]);
 				nvgText(ctx.vg, pos.x + 10, pos.y + 5, text, NULL);
 
-				snprintf(text, sizeof(text), "Length: %d", module->uiPatt->length);
+				snprintf(text, sizeof(text), "Length: %d", state.length);
 				nvgText(ctx.vg, pos.x + 10, pos.y + 25, text, NULL);
 
-				switch(module->uiPatt->scale) {
-					case 0: snprintf(text, sizeof(text), "Transpose: %d s.t.", module->uiPatt->trans); break;
-					case 1: snprintf(text, sizeof(text), "Transpose: %d Maj. int.", module->uiPatt->trans); break;
-					case 2: snprintf(text, sizeof(text), "Transpose: %d Min. int.", module->uiPatt->trans); break;
+				switch(state.scale) {
+					case 0: snprintf(text, sizeof(text), "Transpose: %d s.t.", state.trans); break;
+					case 1: snprintf(text, sizeof(text), "Transpose: %d Maj. int.", state.trans); break;
+					case 2: snprintf(text, sizeof(text), "Transpose: %d Min. int.", state.trans); break;
 					default: snprintf(text, sizeof(text), "Error..."); break;
 				}
 				nvgText(ctx.vg, pos.x + 10, pos.y + 45, text, NULL);
 
-				snprintf(text, sizeof(text), "Arpeggio: %s", module->uiArp->getName().c_str());
+				snprintf(text, sizeof(text), "Arpeggio: %s", ARPEGGIATOR2_ARP_NAMES[state.arp]);
 				nvgText(ctx.vg, pos.x + 10, pos.y + 65, text, NULL);
 			}
 		}
@@ -1071,11 +855,108 @@ struct Arpeggiator2Widget : ModuleWidget {
 			}
 		};
 
+		struct RatchetItem : MenuItem {
+			Arpeggiator2 *module;
+			int ratchets;
+			void onAction(const rack::widget::Widget::ActionEvent &e) override {
+				module->scheduler.ratchets = ratchets;
+			}
+		};
+
+		struct RatchetMenu : MenuItem {
+			Arpeggiator2 *module;
+			Menu *createChildMenu() override {
+				Menu *menu = new Menu;
+				std::vector<int> counts = {1, 2, 3, 4, 6, 8};
+				for (size_t i = 0; i < counts.size(); i++) {
+					std::string name = counts[i] == 1 ? "Off" : std::to_string(counts[i]) + " per step";
+					RatchetItem *item = createMenuItem<RatchetItem>(name, CHECKMARK(module->scheduler.ratchets == counts[i]));
+					item->module = module;
+					item->ratchets = counts[i];
+					menu->addChild(item);
+				}
+				return menu;
+			}
+		};
+
+		struct SwingItem : MenuItem {
+			Arpeggiator2 *module;
+			int swing;
+			void onAction(const rack::widget::Widget::ActionEvent &e) override {
+				module->scheduler.swing = swing;
+			}
+		};
+
+		struct SwingMenu : MenuItem {
+			Arpeggiator2 *module;
+			Menu *createChildMenu() override {
+				Menu *menu = new Menu;
+				std::vector<int> amounts = {50, 54, 58, 62, 66, 71, 75};
+				for (size_t i = 0; i < amounts.size(); i++) {
+					std::string name = amounts[i] == 50 ? "Off" : std::to_string(amounts[i]) + "%";
+					SwingItem *item = createMenuItem<SwingItem>(name, CHECKMARK(module->scheduler.swing == amounts[i]));
+					item->module = module;
+					item->swing = amounts[i];
+					menu->addChild(item);
+				}
+				return menu;
+			}
+		};
+
+		struct SwitchModeItem : MenuItem {
+			Arpeggiator2 *module;
+			digital::PatternSwitch::Mode mode;
+			int bars;
+			void onAction(const rack::widget::Widget::ActionEvent &e) override {
+				module->patternSwitch.mode = mode;
+				module->patternSwitch.bars = bars;
+			}
+		};
+
+		struct SwitchModeMenu : MenuItem {
+			Arpeggiator2 *module;
+			Menu *createChildMenu() override {
+				Menu *menu = new Menu;
+				std::vector<digital::PatternSwitch::Mode> modes = {digital::PatternSwitch::IMMEDIATE, digital::PatternSwitch::AT_EOC, 
+					digital::PatternSwitch::AT_BARS, digital::PatternSwitch::AT_BARS, digital::PatternSwitch::AT_BARS};
+				std::vector<int> bars = {1, 1, 1, 2, 4};
+				std::vector<std::string> names = {"Immediately", "At end of sequence", "Every bar", "Every 2 bars", "Every 4 bars"};
+				for (size_t i = 0; i < modes.size(); i++) {
+					bool checked = module->patternSwitch.mode == modes[i] && (modes[i] != digital::PatternSwitch::AT_BARS || module->patternSwitch.bars == bars[i]);
+					SwitchModeItem *item = createMenuItem<SwitchModeItem>(names[i], CHECKMARK(checked));
+					item->module = module;
+					item->mode = modes[i];
+					item->bars = bars[i];
+					menu->addChild(item);
+				}
+				return menu;
+			}
+		};
+
 		menu->addChild(construct<MenuLabel>());
 		GateModeMenu *item = createMenuItem<GateModeMenu>("Gate Mode");
 		item->module = arp;
 		menu->addChild(item);
 
+		SwitchModeMenu *sitem = createMenuItem<SwitchModeMenu>("Switch to a changed pattern");
+		sitem->module = arp;
+		menu->addChild(sitem);
+
+		RatchetMenu *rtitem = createMenuItem<RatchetMenu>("Ratchets");
+		rtitem->module = arp;
+		menu->addChild(rtitem);
+
+		SwingMenu *switem2 = createMenuItem<SwingMenu>("Swing");
+		switem2->module = arp;
+		menu->addChild(switem2);
+
+#ifndef METAMODULE
+		menu->addChild(construct<MenuLabel>());
+		gui::TraceItem *titem = createMenuItem<gui::TraceItem>("Debug trace to file", CHECKMARK(arp->debugFlag));
+		titem->module = arp;
+		menu->addChild(titem);
+#endif
+
 	}
 
 };
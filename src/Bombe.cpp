@@ -90,6 +90,10 @@ struct Bombe : core::AHModule {
 		json_t *scaleModeJ = json_integer((int) voltScale);
 		json_object_set_new(rootJ, "voltscale", scaleModeJ);
 
+		// voiceLeading
+		json_t *voiceLeadingJ = json_integer((int) voiceLeader.mode);
+		json_object_set_new(rootJ, "voiceLeading", voiceLeadingJ);
+
 		return rootJ;
 	}
 
@@ -111,10 +115,16 @@ struct Bombe : core::AHModule {
 		json_t *scaleModeJ = json_object_get(rootJ, "voltscale");
 		if (scaleModeJ) voltScale = (music::RootScaling)json_integer_value(scaleModeJ);
 
+		// voiceLeading
+		json_t *voiceLeadingJ = json_object_get(rootJ, "voiceLeading");
+		if (voiceLeadingJ) voiceLeader.mode = (music::VoiceLeader::Mode)json_integer_value(voiceLeadingJ);
+
 	}
 
 	music::RootScaling voltScale = music::RootScaling::CIRCLE;
 
+	music::VoiceLeader voiceLeader;
+
  	int MajorScale[7] = {0,2,4,5,7,9,11};
 	int Quality2Chord[N_QUALITIES] = {0, 1, 54}; // M, m, dim
 	int QualityMap[3][QMAP_SIZE] = { 
@@ -135,6 +145,7 @@ struct Bombe : core::AHModule {
 	int currMode = 1;
 	int currInversion = 0;
 	int length = 16;
+	int lockLight = 0;			// 0 = none, 1 = updated, 2 = locked
 
 	int offset = 12; 			// 0 = random, 12 = lower octave, 24 = repeat, 36 = upper octave
 	int mode = 1; 				// 0 = random chord, 1 = chord in key, 2 = chord in mode
@@ -218,11 +229,13 @@ void Bombe::process(const ProcessArgs &args) {
 		if (locked) {
 			// Buffer is locked
 			buffer[0] = lastValue;
+			voiceLeader.follow(buffer[0].outVolts);
 		} else {
 
 			if (random::uniform() < x) {
 				// Buffer update skipped
 				buffer[0] = lastValue;
+				voiceLeader.follow(buffer[0].outVolts);
 			} else {
 				
 				// We are going to update this entry 
@@ -237,6 +250,7 @@ void Bombe::process(const ProcessArgs &args) {
 
 				const music::InversionDefinition &invDef = knownChords.getChord(buffer[0]);
 				buffer[0].setVoltages(invDef.formula, offset);
+				voiceLeader.lead(buffer[0].outVolts, buffer[0].outVolts);
 
 			}
 		}
@@ -258,15 +272,25 @@ void Bombe::process(const ProcessArgs &args) {
 		
 	}
 
-	if (updated) { // Green Update
-		lights[LOCK_LIGHT].setSmoothBrightness(1.0f, args.sampleTime);
-		lights[LOCK_LIGHT + 1].setSmoothBrightness(0.0f, args.sampleTime);
-	} else if (locked) { // Yellow locked
-		lights[LOCK_LIGHT].setSmoothBrightness(0.0f, args.sampleTime);
-		lights[LOCK_LIGHT + 1].setSmoothBrightness(1.0f, args.sampleTime);
-	} else { // No change
-		lights[LOCK_LIGHT].setSmoothBrightness(0.0f, args.sampleTime);
-		lights[LOCK_LIGHT + 1].setSmoothBrightness(0.0f, args.sampleTime);
+	// Hold the clock event until the next light update so it is not missed
+	if (updated) {
+		lockLight = 1;
+	} else if (locked && lockLight == 0) {
+		lockLight = 2;
+	}
+
+	if (lightsDue) {
+		if (lockLight == 1) { // Green Update
+			lights[LOCK_LIGHT].setSmoothBrightness(1.0f, lightTime(args.sampleTime));
+			lights[LOCK_LIGHT + 1].setSmoothBrightness(0.0f, lightTime(args.sampleTime));
+		} else if (lockLight == 2) { // Yellow locked
+			lights[LOCK_LIGHT].setSmoothBrightness(0.0f, lightTime(args.sampleTime));
+			lights[LOCK_LIGHT + 1].setSmoothBrightness(1.0f, lightTime(args.sampleTime));
+		} else { // No change
+			lights[LOCK_LIGHT].setSmoothBrightness(0.0f, lightTime(args.sampleTime));
+			lights[LOCK_LIGHT + 1].setSmoothBrightness(0.0f, lightTime(args.sampleTime));
+		}
+		lockLight = 0;
 	}
 
 	// Set the output pitches 
@@ -422,6 +446,7 @@ struct BombeWidget : ModuleWidget {
 	std::vector<MenuOption<int>> modeOptions;
 	std::vector<MenuOption<int>> invOptions;
 	std::vector<MenuOption<music::RootScaling>> scalingOptions;
+	std::vector<MenuOption<music::VoiceLeader::Mode>> voiceOptions;
 
 	BombeWidget(Bombe *module)  {
 	
@@ -472,6 +497,10 @@ struct BombeWidget : ModuleWidget {
 		scalingOptions.emplace_back(std::string("V/Oct"), music::RootScaling::VOCT);
 		scalingOptions.emplace_back(std::string("Fourths and Fifths"), music::RootScaling::CIRCLE);
 
+		voiceOptions.emplace_back(std::string("Off"), music::VoiceLeader::OFF);
+		voiceOptions.emplace_back(std::string("Closest to the last chord"), music::VoiceLeader::CLOSEST);
+		voiceOptions.emplace_back(std::string("Closest, within an octave of C4"), music::VoiceLeader::CLOSEST_IN_RANGE);
+
 	}
 
 	void appendContextMenu(Menu *menu) override {
@@ -544,6 +573,26 @@ struct BombeWidget : ModuleWidget {
 			}
 		};
 
+		struct VoiceLeadingItem : BombeMenu {
+			music::VoiceLeader::Mode voiceLeading;
+			void onAction(const rack::widget::Widget::ActionEvent &e) override {
+				module->voiceLeader.mode = voiceLeading;
+			}
+		};
+
+		struct VoiceLeadingMenu : BombeMenu {
+			Menu *createChildMenu() override {
+				Menu *menu = new Menu;
+				for (auto opt: parent->voiceOptions) {
+					VoiceLeadingItem *item = createMenuItem<VoiceLeadingItem>(opt.name, CHECKMARK(module->voiceLeader.mode == opt.value));
+					item->module = module;
+					item->voiceLeading = opt.value;
+					menu->addChild(item);
+				}
+				return menu;
+			}
+		};
+
 		struct ScalingItem : BombeMenu {
 			music::RootScaling voltScale;
 			void onAction(const rack::widget::Widget::ActionEvent &e) override {
@@ -585,6 +634,11 @@ struct BombeWidget : ModuleWidget {
 		scaleItem->parent = this;
 		menu->addChild(scaleItem);
 
+		VoiceLeadingMenu *voiceItem = createMenuItem<VoiceLeadingMenu>("Voice Leading");
+		voiceItem->module = bombe;
+		voiceItem->parent = this;
+		menu->addChild(voiceItem);
+
      }
 
 };
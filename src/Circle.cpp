@@ -5,6 +5,13 @@
 
 using namespace ah;
 
+static const char *const CIRCLE_TRACE_NAMES[] = {
+	"Rotate left: key index",
+	"Rotate right: key index",
+	"Reset: key index",
+	"New base: key index"
+};
+
 struct Circle : core::AHModule {
 
 	enum ParamIds {
@@ -30,6 +37,13 @@ struct Circle : core::AHModule {
 		ENUMS(CKEY_LIGHT,12),
 		NUM_LIGHTS
 	};
+	enum TraceIds {
+		TRACE_ROTATE_LEFT,
+		TRACE_ROTATE_RIGHT,
+		TRACE_RESET,
+		TRACE_NEW_BASE,
+		NUM_TRACES
+	};
 
 	music::RootScaling inVoltScale = music::RootScaling::CIRCLE;
 	music::RootScaling outVoltScale = music::RootScaling::CIRCLE;
@@ -42,6 +56,8 @@ struct Circle : core::AHModule {
 		configParam(MODE_PARAM, 0.0, 6.0, 0.0, "Mode"); 
 		paramQuantities[MODE_PARAM]->description = "Mode of progression";
 
+		setTraceNames(CIRCLE_TRACE_NAMES, NUM_TRACES);
+
 	}
 
 	void process(const ProcessArgs &args) override;
@@ -117,9 +133,6 @@ void Circle::process(const ProcessArgs &args) {
 	bool rotRStatus		= rotRTrigger.process(rotRInput);
 
 	if (rotLStatus) {
-		#ifndef METAMODULE
-		if (debugEnabled()) { std::cout << stepX << " Rotate left: " << curKeyIndex; }
-		#endif
 		if (inVoltScale == music::RootScaling::CIRCLE) {
 			curKeyIndex = curKeyIndex == 0 ? 11 : curKeyIndex - 1; // Wrap
 		} else {
@@ -129,15 +142,10 @@ void Circle::process(const ProcessArgs &args) {
 			}
 		}
 
-		#ifndef METAMODULE
-		if (debugEnabled()) { std::cout << " -> " << curKeyIndex << std::endl;	}
-		#endif
+		trace(TRACE_ROTATE_LEFT, curKeyIndex);
 	} 
 
 	if (rotRStatus) {
-		#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " Rotate right: " << curKeyIndex; }
-#endif
 		if (inVoltScale == music::RootScaling::CIRCLE) {
 			curKeyIndex = curKeyIndex == 11 ? 0 : curKeyIndex + 1; // Wrap
 		} else {
@@ -146,22 +154,16 @@ if (debugEnabled()) { std::cout << stepX << " Rotate right: " << curKeyIndex; }
 				curKeyIndex = curKeyIndex + 12;
 			}
 		}
-		#ifndef METAMODULE
-if (debugEnabled()) { std::cout << " -> " << curKeyIndex << std::endl;	}
-#endif
+		trace(TRACE_ROTATE_RIGHT, curKeyIndex);
 	} 
 
 	if (rotLStatus && rotRStatus) {
-		#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " Reset " << curKeyIndex << std::endl;	}
-#endif
+		trace(TRACE_RESET, baseKeyIndex);
 		curKeyIndex = baseKeyIndex;
 	}
 
 	if (newKeyIndex != baseKeyIndex) {
-		#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " New base: " << newKeyIndex << std::endl;}
-#endif
+		trace(TRACE_NEW_BASE, newKeyIndex);
 		baseKeyIndex = newKeyIndex;
 		curKeyIndex = newKeyIndex;
 	}
@@ -186,18 +188,20 @@ if (debugEnabled()) { std::cout << stepX << " New base: " << newKeyIndex << std:
 
 	float modeVolts = music::getVoltsFromMode(curMode);
 
-	for (int i = 0; i < music::Notes::NUM_NOTES; i++) {
-		lights[CKEY_LIGHT + i].setBrightness(0.0);
-		lights[BKEY_LIGHT + i].setBrightness(0.0);
-	}
+	if (lightsDue) {
+		for (int i = 0; i < music::Notes::NUM_NOTES; i++) {
+			lights[CKEY_LIGHT + i].setBrightness(0.0);
+			lights[BKEY_LIGHT + i].setBrightness(0.0);
+		}
 
-	lights[CKEY_LIGHT + curKey].setBrightness(10.0);
-	lights[BKEY_LIGHT + baseKey].setBrightness(10.0);
+		lights[CKEY_LIGHT + curKey].setBrightness(10.0);
+		lights[BKEY_LIGHT + baseKey].setBrightness(10.0);
 
-	for (int i = 0; i < music::Modes::NUM_MODES; i++) {
-		lights[MODE_LIGHT + i].setBrightness(0.0);
+		for (int i = 0; i < music::Modes::NUM_MODES; i++) {
+			lights[MODE_LIGHT + i].setBrightness(0.0);
+		}
+		lights[MODE_LIGHT + curMode].setBrightness(10.0);
 	}
-	lights[MODE_LIGHT + curMode].setBrightness(10.0);
 
 	outputs[KEY_OUTPUT].setVoltage(keyVolts);
 	outputs[MODE_OUTPUT].setVoltage(modeVolts);
@@ -316,6 +320,13 @@ struct CircleWidget : ModuleWidget {
 		outItem->parent = this;
 		menu->addChild(outItem);
 
+#ifndef METAMODULE
+		menu->addChild(construct<MenuLabel>());
+		gui::TraceItem *titem = createMenuItem<gui::TraceItem>("Debug trace to file", CHECKMARK(circle->debugFlag));
+		titem->module = circle;
+		menu->addChild(titem);
+#endif
+
 	}
 
 };
@@ -5,6 +5,11 @@
 
 using namespace ah;
 
+static const char *const GALAXY_TRACE_NAMES[] = {
+	"Random move: rotate, radial",
+	"Move in key: rotate, radial"
+};
+
 struct Galaxy : core::AHModule {
 
 	const static int NUM_PITCHES = 6;
@@ -78,6 +83,11 @@ struct Galaxy : core::AHModule {
 		ENUMS(BAD_LIGHT,2),
 		NUM_LIGHTS
 	};
+	enum TraceIds {
+		TRACE_RANDOM_MOVE,
+		TRACE_KEY_MOVE,
+		NUM_TRACES
+	};
 
 	Galaxy() : core::AHModule(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS) {
 		configParam(KEY_PARAM, 0.0, 11.0, 0.0, "Key");
@@ -89,6 +99,8 @@ struct Galaxy : core::AHModule {
 		configParam(BAD_PARAM, 0.0, 1.0, 0.0, "Bad", "%", 0.0f, 100.0f);
 		paramQuantities[BAD_PARAM]->description = "Deviation from chord selection rule for the mode";
 
+		setTraceNames(GALAXY_TRACE_NAMES, NUM_TRACES);
+
 	}
 
 	void process(const ProcessArgs &args) override;
@@ -116,6 +128,10 @@ struct Galaxy : core::AHModule {
 		json_t *scaleModeJ = json_integer((int) voltScale);
 		json_object_set_new(rootJ, "voltscale", scaleModeJ);
 
+		// voiceLeading
+		json_t *voiceLeadingJ = json_integer((int) voiceLeader.mode);
+		json_object_set_new(rootJ, "voiceLeading", voiceLeadingJ);
+
 		return rootJ;
 	}
 
@@ -137,6 +153,10 @@ struct Galaxy : core::AHModule {
 		json_t *scaleModeJ = json_object_get(rootJ, "voltscale");
 		if (scaleModeJ) voltScale = (music::RootScaling)json_integer_value(scaleModeJ);
 
+		// voiceLeading
+		json_t *voiceLeadingJ = json_object_get(rootJ, "voiceLeading");
+		if (voiceLeadingJ) voiceLeader.mode = (music::VoiceLeader::Mode)json_integer_value(voiceLeadingJ);
+
 	}
 
 	int GalaxyChords[N_QUALITIES] = { 0, 2, 83, 12, 1, 29 }; // M, 7, m7, M7, m, dim
@@ -161,6 +181,8 @@ struct Galaxy : core::AHModule {
 
 	music::RootScaling voltScale = music::RootScaling::CIRCLE;
 
+	music::VoiceLeader voiceLeader;
+
 	int lastQuality = 0;
 	int lastNoteIndex = 0; 
 	int lastInversion = 0;
@@ -168,6 +190,7 @@ struct Galaxy : core::AHModule {
 	int currRoot = 1;
 	int currMode = 1;
 	int light = 0;
+	int badLightLatch = 0;
 
 	bool haveRoot = false;
 	bool haveMode = false;
@@ -263,6 +286,7 @@ void Galaxy::process(const ProcessArgs &args) {
 		const ah::music::InversionDefinition & invDef = knownChords.getChord(currChord);
 	
 		currChord.setVoltages(invDef.formula, offset);
+		voiceLeader.lead(currChord.outVolts, currChord.outVolts);
 
 		if (currChord.quality != lastQuality) {
 			changed = true;
@@ -304,15 +328,23 @@ void Galaxy::process(const ProcessArgs &args) {
 
 	}
 
-	if (badLight == 1) { // Green (scale->key)
-		lights[BAD_LIGHT].setSmoothBrightness(1.0f, args.sampleTime);
-		lights[BAD_LIGHT + 1].setSmoothBrightness(0.0f, args.sampleTime);
-	} else if (badLight == 2) { // Red (->random)
-		lights[BAD_LIGHT].setSmoothBrightness(0.0f, args.sampleTime);
-		lights[BAD_LIGHT + 1].setSmoothBrightness(1.0f, args.sampleTime);
-	} else { // No change
-		lights[BAD_LIGHT].setSmoothBrightness(0.0f, args.sampleTime);
-		lights[BAD_LIGHT + 1].setSmoothBrightness(0.0f, args.sampleTime);
+	// Hold the move event until the next light update so it is not missed
+	if (badLight != 0) {
+		badLightLatch = badLight;
+	}
+
+	if (lightsDue) {
+		if (badLightLatch == 1) { // Green (scale->key)
+			lights[BAD_LIGHT].setSmoothBrightness(1.0f, lightTime(args.sampleTime));
+			lights[BAD_LIGHT + 1].setSmoothBrightness(0.0f, lightTime(args.sampleTime));
+		} else if (badLightLatch == 2) { // Red (->random)
+			lights[BAD_LIGHT].setSmoothBrightness(0.0f, lightTime(args.sampleTime));
+			lights[BAD_LIGHT + 1].setSmoothBrightness(1.0f, lightTime(args.sampleTime));
+		} else { // No change
+			lights[BAD_LIGHT].setSmoothBrightness(0.0f, lightTime(args.sampleTime));
+			lights[BAD_LIGHT + 1].setSmoothBrightness(0.0f, lightTime(args.sampleTime));
+		}
+		badLightLatch = 0;
 	}
 
 	// Set the output pitches 
@@ -337,11 +369,7 @@ void Galaxy::getFromRandom() {
 	int rotateInput = signedRndNotZero(2);
 	int radialInput = signedRndNotZero(2);
 
-	#ifndef METAMODULE
-	if(debugEnabled(5000)) {
-		std::cout << "Rotate: " << rotateInput << "  Radial: " << radialInput << std::endl;
-	}
-	#endif
+	trace(TRACE_RANDOM_MOVE, rotateInput, radialInput);
 
 	// Determine move around the grid
 	currChord.quality += rotateInput;
@@ -357,11 +385,7 @@ void Galaxy::getFromKey() {
 	int rotateInput = signedRndNotZero(2);
 	int radialInput = signedRndNotZero(2);
 
-	#ifndef METAMODULE
-	if(debugEnabled(5000)) {
-		std::cout << "Rotate: " << rotateInput << "  Radial: " << radialInput << std::endl;
-	}
-	#endif
+	trace(TRACE_KEY_MOVE, rotateInput, radialInput);
 
 	// Determine move around the grid
 	currChord.quality += rotateInput;
@@ -444,6 +468,7 @@ struct GalaxyWidget : ModuleWidget {
 	std::vector<MenuOption<int>> modeOptions;
 	std::vector<MenuOption<int>> invOptions;
 	std::vector<MenuOption<music::RootScaling>> scalingOptions;
+	std::vector<MenuOption<music::VoiceLeader::Mode>> voiceOptions;
 
 	GalaxyWidget(Galaxy *module)  {
 	
@@ -512,6 +537,10 @@ struct GalaxyWidget : ModuleWidget {
 		scalingOptions.emplace_back(std::string("V/Oct"), music::RootScaling::VOCT);
 		scalingOptions.emplace_back(std::string("Fourths and Fifths"), music::RootScaling::CIRCLE);
 
+		voiceOptions.emplace_back(std::string("Off"), music::VoiceLeader::OFF);
+		voiceOptions.emplace_back(std::string("Closest to the last chord"), music::VoiceLeader::CLOSEST);
+		voiceOptions.emplace_back(std::string("Closest, within an octave of C4"), music::VoiceLeader::CLOSEST_IN_RANGE);
+
 	}
 
 	void appendContextMenu(Menu *menu) override {
@@ -584,6 +613,26 @@ struct GalaxyWidget : ModuleWidget {
 			}
 		};
 
+		struct VoiceLeadingItem : GalaxyMenu {
+			music::VoiceLeader::Mode voiceLeading;
+			void onAction(const rack::widget::Widget::ActionEvent &e) override {
+				module->voiceLeader.mode = voiceLeading;
+			}
+		};
+
+		struct VoiceLeadingMenu : GalaxyMenu {
+			Menu *createChildMenu() override {
+				Menu *menu = new Menu;
+				for (auto opt: parent->voiceOptions) {
+					VoiceLeadingItem *item = createMenuItem<VoiceLeadingItem>(opt.name, CHECKMARK(module->voiceLeader.mode == opt.value));
+					item->module = module;
+					item->voiceLeading = opt.value;
+					menu->addChild(item);
+				}
+				return menu;
+			}
+		};
+
 		struct ScalingItem : GalaxyMenu {
 			music::RootScaling voltScale;
 			void onAction(const rack::widget::Widget::ActionEvent &e) override {
@@ -626,6 +675,18 @@ struct GalaxyWidget : ModuleWidget {
 		scaleItem->parent = this;
 		menu->addChild(scaleItem);
 
+		VoiceLeadingMenu *voiceItem = createMenuItem<VoiceLeadingMenu>("Voice Leading");
+		voiceItem->module = galaxy;
+		voiceItem->parent = this;
+		menu->addChild(voiceItem);
+
+#ifndef METAMODULE
+		menu->addChild(construct<MenuLabel>());
+		gui::TraceItem *titem = createMenuItem<gui::TraceItem>("Debug trace to file", CHECKMARK(galaxy->debugFlag));
+		titem->module = galaxy;
+		menu->addChild(titem);
+#endif
+
 	}
 
 };
@@ -332,19 +332,25 @@ void Generative::process(const ProcessArgs &args) {
 	if (gatePhase.process(args.sampleTime)) {
 		outputs[GATE_OUTPUT].setVoltage(10.0f);
 
-		lights[GATE_LIGHT].setSmoothBrightness(1.0f, args.sampleTime);
-		lights[GATE_LIGHT + 1].setSmoothBrightness(0.0f, args.sampleTime);
+		if (lightsDue) {
+			lights[GATE_LIGHT].setSmoothBrightness(1.0f, lightTime(args.sampleTime));
+			lights[GATE_LIGHT + 1].setSmoothBrightness(0.0f, lightTime(args.sampleTime));
+		}
 
 	} else {
 		outputs[GATE_OUTPUT].setVoltage(0.0f);
 		gateState = false;
 
 		if (delayState) {
-			lights[GATE_LIGHT].setSmoothBrightness(0.0f, args.sampleTime);
-			lights[GATE_LIGHT + 1].setSmoothBrightness(1.0f, args.sampleTime);
+			if (lightsDue) {
+				lights[GATE_LIGHT].setSmoothBrightness(0.0f, lightTime(args.sampleTime));
+				lights[GATE_LIGHT + 1].setSmoothBrightness(1.0f, lightTime(args.sampleTime));
+			}
 		} else {
-			lights[GATE_LIGHT].setSmoothBrightness(0.0f, args.sampleTime);
-			lights[GATE_LIGHT + 1].setSmoothBrightness(0.0f, args.sampleTime);
+			if (lightsDue) {
+				lights[GATE_LIGHT].setSmoothBrightness(0.0f, lightTime(args.sampleTime));
+				lights[GATE_LIGHT + 1].setSmoothBrightness(0.0f, lightTime(args.sampleTime));
+			}
 		}
 
 	}
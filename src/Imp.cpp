@@ -167,17 +167,23 @@ void Imp::process(const ProcessArgs &args) {
 	}
 
 	if (coreState.gatePhase.process(args.sampleTime)) {
-		lights[OUT_LIGHT].setSmoothBrightness(1.0f, args.sampleTime);
-		lights[OUT_LIGHT + 1].setSmoothBrightness(0.0f, args.sampleTime);
+		if (lightsDue) {
+			lights[OUT_LIGHT].setSmoothBrightness(1.0f, lightTime(args.sampleTime));
+			lights[OUT_LIGHT + 1].setSmoothBrightness(0.0f, lightTime(args.sampleTime));
+		}
 	} else {
 		coreState.gateState = false;
 
 		if (coreState.delayState) {
-			lights[OUT_LIGHT].setSmoothBrightness(0.0f, args.sampleTime);
-			lights[OUT_LIGHT + 1].setSmoothBrightness(1.0f, args.sampleTime);
+			if (lightsDue) {
+				lights[OUT_LIGHT].setSmoothBrightness(0.0f, lightTime(args.sampleTime));
+				lights[OUT_LIGHT + 1].setSmoothBrightness(1.0f, lightTime(args.sampleTime));
+			}
 		} else {
-			lights[OUT_LIGHT].setSmoothBrightness(0.0f, args.sampleTime);
-			lights[OUT_LIGHT + 1].setSmoothBrightness(0.0f, args.sampleTime);
+			if (lightsDue) {
+				lights[OUT_LIGHT].setSmoothBrightness(0.0f, lightTime(args.sampleTime));
+				lights[OUT_LIGHT + 1].setSmoothBrightness(0.0f, lightTime(args.sampleTime));
+			}
 		}
 	}
 
@@ -6,6 +6,10 @@
 
 using namespace ah;
 
+static const char *const IMPERFECT2_TRACE_NAMES[] = {
+	"Active out follows trigger: row, triggered row"
+};
+
 struct Imperfect2 : core::AHModule {
 
 	enum ParamIds {
@@ -32,6 +36,10 @@ struct Imperfect2 : core::AHModule {
 		ENUMS(OUT_LIGHT,8),
 		NUM_LIGHTS
 	};
+	enum TraceIds {
+		TRACE_FOLLOW_TRIGGER,
+		NUM_TRACES
+	};
 
 	Imperfect2() : core::AHModule(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS) {
 
@@ -51,6 +59,7 @@ struct Imperfect2 : core::AHModule {
 		}
 
 		onReset();
+		setTraceNames(IMPERFECT2_TRACE_NAMES, NUM_TRACES);
 
 	}
 
@@ -101,9 +110,7 @@ void Imperfect2::process(const ProcessArgs &args) {
 		} else {
 			// We have an output plugged in this row and previously seen a trigger on previous row
 			if (outputActive && lastValidInput > -1) {
-				#ifndef METAMODULE
-if (debugEnabled()) { std::cout << stepX << " " << i << " has active out and has seen trigger on " << lastValidInput << std::endl; }
-#endif
+				if (debugEnabled(5000)) { trace(TRACE_FOLLOW_TRIGGER, i, lastValidInput); }
 				generateSignal = true;
 			}
 
@@ -169,19 +176,25 @@ if (debugEnabled()) { std::cout << stepX << " " << i << " has active out and has
 		if (state[i].gatePhase.process(args.sampleTime)) {
 			outputs[OUT_OUTPUT + i].setVoltage(10.0f);
 
-			lights[OUT_LIGHT + i * 2].setSmoothBrightness(1.0f, args.sampleTime);
-			lights[OUT_LIGHT + i * 2 + 1].setSmoothBrightness(0.0f, args.sampleTime);
+			if (lightsDue) {
+				lights[OUT_LIGHT + i * 2].setSmoothBrightness(1.0f, lightTime(args.sampleTime));
+				lights[OUT_LIGHT + i * 2 + 1].setSmoothBrightness(0.0f, lightTime(args.sampleTime));
+			}
 
 		} else {
 			outputs[OUT_OUTPUT + i].setVoltage(0.0f);
 			state[i].gateState = false;
 
 			if (state[i].delayState) {
-				lights[OUT_LIGHT + i * 2].setSmoothBrightness(0.0f, args.sampleTime);
-				lights[OUT_LIGHT + i * 2 + 1].setSmoothBrightness(1.0f, args.sampleTime);
+				if (lightsDue) {
+					lights[OUT_LIGHT + i * 2].setSmoothBrightness(0.0f, lightTime(args.sampleTime));
+					lights[OUT_LIGHT + i * 2 + 1].setSmoothBrightness(1.0f, lightTime(args.sampleTime));
+				}
 			} else {
-				lights[OUT_LIGHT + i * 2].setSmoothBrightness(0.0f, args.sampleTime);
-				lights[OUT_LIGHT + i * 2 + 1].setSmoothBrightness(0.0f, args.sampleTime);
+				if (lightsDue) {
+					lights[OUT_LIGHT + i * 2].setSmoothBrightness(0.0f, lightTime(args.sampleTime));
+					lights[OUT_LIGHT + i * 2 + 1].setSmoothBrightness(0.0f, lightTime(args.sampleTime));
+				}
 			}
 		}
 	}
@@ -369,6 +382,21 @@ struct Imperfect2Widget : ModuleWidget {
 			}
 		}
 	}
+
+#ifndef METAMODULE
+	void appendContextMenu(Menu *menu) override {
+
+		Imperfect2 *imperfect = dynamic_cast<Imperfect2*>(module);
+		assert(imperfect);
+
+		menu->addChild(construct<MenuLabel>());
+		gui::TraceItem *titem = createMenuItem<gui::TraceItem>("Debug trace to file", CHECKMARK(imperfect->debugFlag));
+		titem->module = imperfect;
+		menu->addChild(titem);
+
+	}
+#endif
+
 };
 
 Model *modelImperfect2 = createModel<Imperfect2, Imperfect2Widget>("Imperfect2");
@@ -5,6 +5,32 @@
 
 using namespace ah;
 
+// Chords the original Progress had that the shared chord set does not, numbered on from the end of it
+static const music::ChordFormula LEGACY_ONLY_CHORDS[] = {
+	{"7#5sus4", {0, 5, 8, 10}}
+};
+
+// The chord knob positions of the original Progress (1 - 98, grouped major, minor, diminished), as indices into
+// music::BasicChordSet, or LEGACY_ONLY_CHORDS past its end. Position 0 was an unused "None" chord
+static const int NUM_LEGACY_CHORDS = 99;
+static const int LEGACY_CHORDS[NUM_LEGACY_CHORDS] = {
+	0, 0, 73, 74, 67, 76, 79, 80, 81, 10,
+	18, 20, 9, 8, 12, 17, 11, 19, 45, 46,
+	49, 51, 50, 52, 48, 7, 75, 77, 3, 4,
+	47, 6, 44, 53, 66, 65, 69, 70, 68, 71,
+	72, 78, 24, 25, 13, 15, 14, 16, 98, 21,
+	22, 23, 26, 30, 27, 28, 29, 32, 31, 33,
+	34, 35, 36, 37, 58, 59, 60, 62, 61, 63,
+	64, 1, 83, 92, 93, 94, 85, 86, 38, 42,
+	41, 43, 89, 84, 90, 39, 40, 91, 82, 87,
+	88, 54, 57, 55, 56, 5, 95, 96, 97
+};
+
+static const music::ChordFormula &legacyFormula(int chord) {
+	int nBasic = music::BasicChordSet.size();
+	return chord < nBasic ? music::BasicChordSet[chord] : LEGACY_ONLY_CHORDS[chord - nBasic];
+}
+
 struct Progress : core::AHModule {
 
 	const static int NUM_PITCHES = 6;
@@ -62,11 +88,30 @@ struct Progress : core::AHModule {
 			configParam(GATE_PARAM + i, 0.0, 1.0, 0.0, "Gate active");
 		}
 
+		// Step and tempo controls are latched at control rate, the clock and reset stay sample-accurate
+		configControlParam(CLOCK_PARAM);
+		configControlParam(STEPS_PARAM);
+		configControlParams(ROOT_PARAM, 8);
+		configControlParams(CHORD_PARAM, 8);
+		configControlParams(INV_PARAM, 8);
+		configControlInput(KEY_INPUT);
+		configControlInput(MODE_INPUT);
+		configControlInput(CLOCK_INPUT);
+		configControlInput(STEPS_INPUT);
+
 		onReset();
 
 	}
 
 	void process(const ProcessArgs &args) override;
+	void updateSteps();
+	void resolveStep(int step);
+
+	void onControlParamChange(int paramId) override {
+		if (paramId >= ROOT_PARAM && paramId < GATE_PARAM) {
+			dirtySteps |= 1 << ((paramId - ROOT_PARAM) % 8);
+		}
+	}
 
 	enum ParamType {
 		ROOT_TYPE,
@@ -74,24 +119,42 @@ struct Progress : core::AHModule {
 		INV_TYPE
 	};
 
+	// What the state display needs of the step, in core::ParamState::detail
+	enum StateDetail {
+		ROOT_DETAIL,
+		CHORD_DETAIL,
+		INV_DETAIL,
+		MODE_DETAIL, // -1 outside mode mode
+		DEGREE_DETAIL
+	};
+
 	void receiveEvent(core::ParamEvent e) override {
 		if (receiveEvents && e.pType != -1) { // AHParamWidgets that are no config through set<>() have a pType of -1
-			if (modeMode) {
-				paramState = "> " + 
-					music::noteNames[currRoot[e.pId]] + 
-					music::ChordTable[currChord[e.pId]].name + " " +  
-					music::inversionNames[currInv[e.pId]] + " " + "[" + 
-					music::DegreeString[currMode][currDegree[e.pId]] + "]";
-			} else {
-				paramState = "> " + 
-					music::noteNames[currRoot[e.pId]] + 
-					music::ChordTable[currChord[e.pId]].name + " " +  
-					music::inversionNames[currInv[e.pId]];
-			}
+			paramState.keep = 1;
+			paramState.pType = e.pType;
+			paramState.pId = e.pId;
+			paramState.value = e.value;
+			paramState.detail[ROOT_DETAIL] = currRoot[e.pId];
+			paramState.detail[CHORD_DETAIL] = currChord[e.pId];
+			paramState.detail[INV_DETAIL] = currInv[e.pId];
+			paramState.detail[MODE_DETAIL] = modeMode ? currMode : -1;
+			paramState.detail[DEGREE_DETAIL] = modeMode ? currDegree[e.pId] : 0;
+			paramDisplay.publish(paramState);
 		}
 		keepStateDisplay = 0;
 	}
 
+	std::string formatParamState(const core::ParamState &state) override {
+		std::string text = "> " + 
+			music::noteNames[state.detail[ROOT_DETAIL]] + 
+			legacyFormula(state.detail[CHORD_DETAIL]).name + " " +  
+			music::inversionNames[state.detail[INV_DETAIL]];
+		if (state.detail[MODE_DETAIL] >= 0) {
+			text += " [" + music::DegreeString[state.detail[MODE_DETAIL]][state.detail[DEGREE_DETAIL]] + "]";
+		}
+		return text;
+	}
+
 	json_t *dataToJson() override {
 		json_t *rootJ = json_object();
 
@@ -146,6 +209,7 @@ struct Progress : core::AHModule {
 	rack::dsp::SchmittTrigger gateTriggers[8];
 
 	rack::dsp::PulseGenerator gatePulse;
+	bool pulseLight = false;
 
 	/** Phase of internal LFO */
 	float phase = 0.0f;
@@ -168,33 +232,17 @@ struct Progress : core::AHModule {
 	bool modeMode = false;
 	bool prevModeMode = false;
 
-	int offset = 24; 	// Repeated notes in chord and expressed in the chord definition as being transposed 2 octaves lower. 
-						// When played this offset needs to be removed (or the notes removed, or the notes transposed to an octave higher)
-
-	float prevRootInput[8] = {-100.0, -100.0, -100.0, -100.0, -100.0, -100.0, -100.0, -100.0};
-	float prevChrInput[8] = {-100.0, -100.0, -100.0, -100.0, -100.0, -100.0, -100.0, -100.0};
-
-	float prevDegreeInput[8] = {-100.0, -100.0, -100.0, -100.0, -100.0, -100.0, -100.0, -100.0};
-	float prevQualityInput[8] = {-100.0, -100.0, -100.0, -100.0, -100.0, -100.0, -100.0, -100.0};
-
-	float prevInvInput[8] = {-100.0, -100.0, -100.0, -100.0, -100.0, -100.0, -100.0, -100.0};
-
-	float currRootInput[8];
-	float currChrInput[8];
-
-	float currDegreeInput[8];
-	float currQualityInput[8];
-
-	float currInvInput[8];
+	// Steps whose controls have moved since their chord was last resolved
+	uint8_t dirtySteps = 0xFF;
 
 	int currMode;
 	int currKey;
 	int prevMode = -1;
 	int prevKey = -1;
 
-	int currRoot[8];
-	int currChord[8];
-	int currInv[8];	
+	int currRoot[8] = {};
+	int currChord[8] = {};
+	int currInv[8] = {};
 
 	int currDegree[8];
 	int currQuality[8];
@@ -228,18 +276,20 @@ void Progress::process(const ProcessArgs &args) {
 		running = !running;
 	}
 
-	int numSteps = (int) clamp(roundf(params[STEPS_PARAM].getValue() + inputs[STEPS_INPUT].getVoltage()), 1.0f, 8.0f);
+	int numSteps = (int) clamp(roundf(getControlParam(STEPS_PARAM) + getControlInput(STEPS_INPUT)), 1.0f, 8.0f);
 
 	if (running) {
 		if (inputs[EXT_CLOCK_INPUT].isConnected()) {
 			// External clock
 			if (clockTrigger.process(inputs[EXT_CLOCK_INPUT].getVoltage())) {
+				// Make sure the new step sees the current controls
+				latchControls();
 				setIndex(index + 1, numSteps);
 			}
 		}
 		else {
 			// Internal clock
-			float clockTime = powf(2.0f, params[CLOCK_PARAM].getValue() + inputs[CLOCK_INPUT].getVoltage());
+			float clockTime = powf(2.0f, getControlParam(CLOCK_PARAM) + getControlInput(CLOCK_INPUT));
 			phase += clockTime * args.sampleTime;
 			if (phase >= 1.0f) {
 				setIndex(index + 1, numSteps);
@@ -249,156 +299,13 @@ void Progress::process(const ProcessArgs &args) {
 
 	// Reset
 	if (resetTrigger.process(params[RESET_PARAM].getValue() + inputs[RESET_INPUT].getVoltage())) {
+		latchControls();
 		setIndex(0, numSteps);
 	}
 
-	bool haveRoot = false;
-	bool haveMode = false;
-
-	// index is our current step
-	if (inputs[KEY_INPUT].isConnected()) {
-		float fRoot = inputs[KEY_INPUT].getVoltage();
-		currKey = music::getKeyFromVolts(fRoot);
-		haveRoot = true;
-	}
-
-	if (inputs[MODE_INPUT].isConnected()) {
-		float fMode = inputs[MODE_INPUT].getVoltage();
-		currMode = music::getModeFromVolts(fMode);	
-		haveMode = true;
-	}
-	
-	modeMode = haveRoot && haveMode;
-	
-	 if (modeMode && ((prevMode != currMode) || (prevKey != currKey))) { // Input changes so force re-read
-	 	for (int step = 0; step < 8; step++) {
-			prevDegreeInput[step]    = -100.0;
-			prevQualityInput[step]  = -100.0;
-		}
-		
-		prevMode = currMode;
-		prevKey = currKey;
-		
-	}
-
-	// Read inputs
-	for (int step = 0; step < 8; step++) {
-		if (modeMode) {
-			currDegreeInput[step]  = params[CHORD_PARAM + step].getValue();
-			currQualityInput[step] = params[ROOT_PARAM + step].getValue();
-			if (prevModeMode != modeMode) { // Switching mode, so reset history to ensure re-read on return
-				prevChrInput[step]  = -100.0;
-				prevRootInput[step]  = -100.0;
-			}
-		} else {
-			currChrInput[step]  = params[CHORD_PARAM + step].getValue();
-			currRootInput[step] = params[ROOT_PARAM + step].getValue();
-			if (prevModeMode != modeMode) { // Switching mode, so reset history to ensure re-read on return
-				prevDegreeInput[step]  = -100.0;
-				prevQualityInput[step]  = -100.0;
-			}
-		}
-		currInvInput[step]  = params[INV_PARAM + step].getValue();
-	}
-
-	// Remember mode
-	prevModeMode = modeMode;
-
-	// Check for changes on all steps
-	for (int step = 0; step < 8; step++) {
-
-		bool update = false;
-
-		if (modeMode) {
-
-			currDegreeInput[step]   = params[ROOT_PARAM + step].getValue();
-			currQualityInput[step] = params[CHORD_PARAM + step].getValue();
-
-			if (prevDegreeInput[step] != currDegreeInput[step]) {
-				prevDegreeInput[step] = currDegreeInput[step];
-				update = true;
-			}
-
-			if (prevQualityInput[step] != currQualityInput[step]) {
-				prevQualityInput[step]  = currQualityInput[step]; 
-				update = true;
-			}
-
-			if (update) {
-
-				// Get Degree (I- VII)
-				currDegree[step] = round(rescale(fabs(currDegreeInput[step]), 0.0f, 10.0f, 0.0f, music::NUM_DEGREES - 1)); 
-
-				// From the input root, mode and degree, we can get the root chord note and quality (Major,Minor,Diminshed)
-				music::getRootFromMode(currMode,currKey,currDegree[step],&currRoot[step],&currQuality[step]);
-
-				// Now get the actual chord from the main list
-				switch(currQuality[step]) {
-					case music::Quality::MAJ: 
-						currChord[step] = round(rescale(fabs(currQualityInput[step]), 0.0f, 10.0f, 1.0f, 70.0f)); 
-						break;
-					case music::Quality::MIN: 
-						currChord[step] = round(rescale(fabs(currQualityInput[step]), 0.0f, 10.0f, 71.0f, 90.0f));
-						break;
-					case music::Quality::DIM: 
-						currChord[step] = round(rescale(fabs(currQualityInput[step]), 0.0f, 10.0f, 91.0f, 98.0f));
-						break;		
-				}
-
-			}
-
-		} else {
-			
-			// Chord Mode
-			
-			// If anything has changed, recalculate output for that step
-			if (prevRootInput[step] != currRootInput[step]) {
-				prevRootInput[step] = currRootInput[step];
-				currRoot[step] = round(rescale(fabs(currRootInput[step]), 0.0f, 10.0f, 0.0f, music::Notes::NUM_NOTES - 1)); // Param range is 0 to 10, mapped to 0 to 11
-				update = true;
-			}
-
-			if (prevChrInput[step] != currChrInput[step]) {
-				prevChrInput[step]  = currChrInput[step]; 
-				currChord[step] = round(rescale(fabs(currChrInput[step]), 0.0f, 10.0f, 1.0f, 98.0f)); // Param range is 0 to 10		
-				update = true;
-			}
-
-		}
-
-		// Inversions remain the same between Chord and Mode mode
-		if (prevInvInput[step] != currInvInput[step]) {
-			prevInvInput[step]  = currInvInput[step];
-			currInv[step] = currInvInput[step];
-			update = true;
-		}
-
-		// So, after all that, we calculate the pitch output
-		if (update) {
-
-			int *chordArray;
-
-			// Get the array of pitches based on the inversion
-			switch(currInv[step]) {
-				case music::Inversion::ROOT:		chordArray = music::ChordTable[currChord[step]].root; 	break;
-				case music::Inversion::FIRST_INV:	chordArray = music::ChordTable[currChord[step]].first; 	break;
-				case music::Inversion::SECOND_INV:	chordArray = music::ChordTable[currChord[step]].second;	break;
-				default: chordArray = music::ChordTable[currChord[step]].root;
-			}
-
-			for (int j = 0; j < NUM_PITCHES; j++) {
-
-				// Set the pitches for this step. If the chord has less than 6 notes, the empty slots are
-				// filled with repeated notes. These notes are identified by a  24 semi-tome negative
-				// offset. We correct for that offset now, pitching thaem back into the original octave.
-				// They could be pitched into the octave above (or below)
-				if (chordArray[j] < 0) {
-					pitches[step][j] = music::getVoltsFromPitch(chordArray[j] + offset,currRoot[step]);
-				} else {
-					pitches[step][j] = music::getVoltsFromPitch(chordArray[j],currRoot[step]);
-				}
-			}
-		}
+	// The chord on each step only changes when the controls have been re-sampled
+	if (controlDue) {
+		updateSteps();
 	}
 
 	bool pulse = gatePulse.process(args.sampleTime);
@@ -418,25 +325,29 @@ void Progress::process(const ProcessArgs &args) {
 
 		outputs[GATE_OUTPUT + i].setVoltage(gateOn ? 10.0f : 0.0f);	
 
+		if (!lightsDue) {
+			continue;
+		}
+
 		if (i == index) {
 			if (gates[i]) {
 				// Gate is on and active = flash green
-				lights[GATE_LIGHTS + i * 2].setSmoothBrightness(1.0f, args.sampleTime);
-				lights[GATE_LIGHTS + i * 2 + 1].setSmoothBrightness(0.0f, args.sampleTime);
+				lights[GATE_LIGHTS + i * 2].setSmoothBrightness(1.0f, lightTime(args.sampleTime));
+				lights[GATE_LIGHTS + i * 2 + 1].setSmoothBrightness(0.0f, lightTime(args.sampleTime));
 			} else {
 				// Gate is off and active = flash dull yellow
-				lights[GATE_LIGHTS + i * 2].setSmoothBrightness(0.20f, args.sampleTime);
-				lights[GATE_LIGHTS + i * 2 + 1].setSmoothBrightness(0.20f, args.sampleTime);
+				lights[GATE_LIGHTS + i * 2].setSmoothBrightness(0.20f, lightTime(args.sampleTime));
+				lights[GATE_LIGHTS + i * 2 + 1].setSmoothBrightness(0.20f, lightTime(args.sampleTime));
 			}
 		} else {
 			if (gates[i]) {
 				// Gate is on and not active = red
-				lights[GATE_LIGHTS + i * 2].setSmoothBrightness(0.0f, args.sampleTime);
-				lights[GATE_LIGHTS + i * 2 + 1].setSmoothBrightness(1.0f, args.sampleTime);
+				lights[GATE_LIGHTS + i * 2].setSmoothBrightness(0.0f, lightTime(args.sampleTime));
+				lights[GATE_LIGHTS + i * 2 + 1].setSmoothBrightness(1.0f, lightTime(args.sampleTime));
 			} else {
 				// Gate is off and not active = black
-				lights[GATE_LIGHTS + i * 2].setSmoothBrightness(0.0f, args.sampleTime);
-				lights[GATE_LIGHTS + i * 2 + 1].setSmoothBrightness(0.0f, args.sampleTime);
+				lights[GATE_LIGHTS + i * 2].setSmoothBrightness(0.0f, lightTime(args.sampleTime));
+				lights[GATE_LIGHTS + i * 2 + 1].setSmoothBrightness(0.0f, lightTime(args.sampleTime));
 			}
 		}
 	}
@@ -450,9 +361,15 @@ void Progress::process(const ProcessArgs &args) {
 
 	// Outputs
 	outputs[GATES_OUTPUT].setVoltage(gatesOn ? 10.0f : 0.0f);
-	lights[RUNNING_LIGHT].setBrightness(running);
-	lights[RESET_LIGHT].setSmoothBrightness(resetTrigger.isHigh(), args.sampleTime);
-	lights[GATES_LIGHT].setSmoothBrightness(pulse, args.sampleTime);
+
+	// Hold the gate pulse until the next light update so it is not missed
+	pulseLight = pulseLight || pulse;
+	if (lightsDue) {
+		lights[RUNNING_LIGHT].setBrightness(running);
+		lights[RESET_LIGHT].setSmoothBrightness(resetTrigger.isHigh(), lightTime(args.sampleTime));
+		lights[GATES_LIGHT].setSmoothBrightness(pulseLight, lightTime(args.sampleTime));
+		pulseLight = false;
+	}
 
 	// Set the output pitches 
 	for (int i = 0; i < NUM_PITCHES; i++) {
@@ -461,6 +378,103 @@ void Progress::process(const ProcessArgs &args) {
 
 }
 
+void Progress::updateSteps() {
+
+	bool haveRoot = false;
+	bool haveMode = false;
+
+	// index is our current step
+	if (isControlConnected(KEY_INPUT)) {
+		float fRoot = getControlInput(KEY_INPUT);
+		currKey = music::getKeyFromVolts(fRoot);
+		haveRoot = true;
+	}
+
+	if (isControlConnected(MODE_INPUT)) {
+		float fMode = getControlInput(MODE_INPUT);
+		currMode = music::getModeFromVolts(fMode);	
+		haveMode = true;
+	}
+	
+	modeMode = haveRoot && haveMode;
+
+	// Switching between chord and mode mode, or moving the key or mode, changes every step
+	if ((prevModeMode != modeMode) || (modeMode && ((prevMode != currMode) || (prevKey != currKey)))) {
+		dirtySteps = 0xFF;
+		prevModeMode = modeMode;
+		prevMode = currMode;
+		prevKey = currKey;
+	}
+
+	// Only the steps whose knobs have moved need their pitches recalculating
+	while (dirtySteps) {
+		int step = __builtin_ctz(dirtySteps);
+		dirtySteps &= dirtySteps - 1;
+		resolveStep(step);
+	}
+
+}
+
+void Progress::resolveStep(int step) {
+
+	int legacyChord = 1;
+
+	if (modeMode) {
+
+		// Get Degree (I- VII)
+		currDegree[step] = round(rescale(fabs(getControlParam(ROOT_PARAM + step)), 0.0f, 10.0f, 0.0f, music::NUM_DEGREES - 1)); 
+
+		// From the input root, mode and degree, we can get the root chord note and quality (Major,Minor,Diminshed)
+		music::getRootFromMode(currMode,currKey,currDegree[step],&currRoot[step],&currQuality[step]);
+
+		// Now get the actual chord from the main list
+		float qualityInput = fabs(getControlParam(CHORD_PARAM + step));
+		switch(currQuality[step]) {
+			case music::Quality::MAJ: 
+				legacyChord = round(rescale(qualityInput, 0.0f, 10.0f, 1.0f, 70.0f)); 
+				break;
+			case music::Quality::MIN: 
+				legacyChord = round(rescale(qualityInput, 0.0f, 10.0f, 71.0f, 90.0f));
+				break;
+			case music::Quality::DIM: 
+				legacyChord = round(rescale(qualityInput, 0.0f, 10.0f, 91.0f, 98.0f));
+				break;		
+		}
+
+	} else {
+
+		// Chord Mode
+		currRoot[step] = round(rescale(fabs(getControlParam(ROOT_PARAM + step)), 0.0f, 10.0f, 0.0f, music::Notes::NUM_NOTES - 1)); // Param range is 0 to 10, mapped to 0 to 11
+		legacyChord = round(rescale(fabs(getControlParam(CHORD_PARAM + step)), 0.0f, 10.0f, 1.0f, 98.0f)); // Param range is 0 to 10		
+
+	}
+
+	currChord[step] = LEGACY_CHORDS[clamp(legacyChord, 1, NUM_LEGACY_CHORDS - 1)];
+
+	// Inversions remain the same between Chord and Mode mode
+	currInv[step] = clamp((int)getControlParam(INV_PARAM + step), 0, music::Inversion::NUM_INV - 1);
+
+	// Progress inverts by lifting the lowest notes of the root position by an octave, rather than using the 
+	// inversions of the chord definition, so patches keep the voicing they were made with
+	const std::vector<int> &formula = legacyFormula(currChord[step]).root;
+	int nNotes = std::min((int)formula.size(), NUM_PITCHES);
+
+	int chordArray[NUM_PITCHES];
+	for (int j = 0; j < nNotes; j++) {
+		chordArray[j] = formula[j] + (j < currInv[step] ? 12 : 0);
+	}
+
+	// If the chord has less than 6 notes, the empty slots are filled with repeated notes
+	for (int j = nNotes; j < NUM_PITCHES; j++) {
+		chordArray[j] = chordArray[j - nNotes];
+	}
+
+	for (int j = 0; j < NUM_PITCHES; j++) {
+		pitches[step][j] = music::getVoltsFromPitch(chordArray[j],currRoot[step]);
+	}
+
+}
+
 struct ProgressWidget : ModuleWidget {
 
 	template <typename T = gui::AHParamWidget>
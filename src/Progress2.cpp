@@ -34,12 +34,15 @@ struct Progress2 : core::AHModule {
 		STEPS_INPUT,
 		PART_INPUT,
 		STEP_INPUT,
+		WRITECV_INPUT,
+		WRITE_INPUT,
 		NUM_INPUTS
 	};
 	enum OutputIds {
 		GATES_OUTPUT,
 		PITCH_OUTPUT,
 		ENUMS(GATE_OUTPUT,8),
+		STEP_GATES_OUTPUT,
 		NUM_OUTPUTS
 	};
 	enum LightIds {
@@ -56,7 +59,8 @@ struct Progress2 : core::AHModule {
 		configParam(CLOCK_PARAM, -2.0, 6.0, 2.0, "Clock tempo", " bpm", 2.f, 60.f);
 		configParam(RUN_PARAM, 0.0, 1.0, 0.0, "Run");
 		configParam(RESET_PARAM, 0.0, 1.0, 0.0, "Reset");
-		configParam(STEPS_PARAM, 1.0, 8.0, 8.0, "Steps");
+		configParam(STEPS_PARAM, 1.0, MAX_STEPS, 8.0, "Steps");
+		paramQuantities[STEPS_PARAM]->description = "Up to the length of the part, 8, 16 or 32 steps";
 
 		configParam(KEY_PARAM, 0.0, 11.0, 0.0, "Key");
 		paramQuantities[KEY_PARAM]->description = "Key from which chords are selected"; 
@@ -70,8 +74,14 @@ struct Progress2 : core::AHModule {
 
 		for (int i = 0; i < 8; i++) {
 			configParam(GATE_PARAM + i, 0.0, 1.0, 0.0, "Gate active");
+			configOutput(GATE_OUTPUT + i, "Step " + std::to_string(i + 1) + " gate");
 		}
 
+		configInput(WRITECV_INPUT, "Step to write (Poly), channels 1-6: root, chord, inversion, octave, then optionally part and step");
+		configInput(WRITE_INPUT, "Trigger: Write step");
+
+		configOutput(STEP_GATES_OUTPUT, "Step gates (Poly), one channel per step. With more than 16 steps, steps 17-32 share channels 1-16 with steps 1-16");
+
 		onReset();
 
 	}
@@ -95,6 +105,16 @@ struct Progress2 : core::AHModule {
 		json_t *scaleModeJ = json_integer((int) voltScale);
 		json_object_set_new(rootJ, "voltscale", scaleModeJ);
 
+		// voiceLeading
+		json_t *voiceLeadingJ = json_integer((int) voiceLeader.mode);
+		json_object_set_new(rootJ, "voiceLeading", voiceLeadingJ);
+
+		// songMode
+		json_object_set_new(rootJ, "songMode", json_boolean(songMode));
+
+		// song
+		json_object_set_new(rootJ, "song", json_string(songSource.c_str()));
+
 		return rootJ;
 	}
 
@@ -116,10 +136,121 @@ struct Progress2 : core::AHModule {
 		json_t *scaleModeJ = json_object_get(rootJ, "voltscale");
 		if (scaleModeJ) voltScale = (music::RootScaling)json_integer_value(scaleModeJ);
 
+		// voiceLeading
+		json_t *voiceLeadingJ = json_object_get(rootJ, "voiceLeading");
+		if (voiceLeadingJ) voiceLeader.mode = (music::VoiceLeader::Mode)json_integer_value(voiceLeadingJ);
+
+		// songMode
+		json_t *songModeJ = json_object_get(rootJ, "songMode");
+		if (songModeJ) songMode = json_is_true(songModeJ);
+
+		// song
+		json_t *songJ = json_object_get(rootJ, "song");
+		if (songJ) setSong(json_string_value(songJ));
+
+	}
+
+	// Song mode. The chain is typed as a list of parts, each with an optional repeat count, e.g. "0x4 1x2 2 0".
+	// It is compiled on the UI thread into a flat schedule with one entry per pass through a part, so on the beat
+	// the audio thread only steps to the next entry
+	static const int MAX_SONG_PASSES = 256;
+
+	struct SongSchedule {
+		int nPasses = 0;
+		uint8_t parts[MAX_SONG_PASSES];
+	};
+
+	bool songMode = false;
+	std::string songSource;
+	std::string songError;
+	core::EventQueue<SongSchedule, 4> songLoads;
+
+	SongSchedule song;
+	int songPass = 0;
+
+	static bool compileSong(const std::string &source, SongSchedule &schedule, std::string &error) {
+
+		schedule.nPasses = 0;
+
+		const char *c = source.c_str();
+		while (*c) {
+
+			if (isspace(*c) || *c == ',') {
+				c++;
+				continue;
+			}
+
+			char *end;
+			long part = strtol(c, &end, 10);
+			if (end == c || part < 0 || part > 31) {
+				error = "Parts are 0 to 31";
+				return false;
+			}
+			c = end;
+
+			long repeats = 1;
+			if (*c == 'x' || *c == 'X' || *c == '*') {
+				c++;
+				repeats = strtol(c, &end, 10);
+				if (end == c || repeats < 1) {
+					error = "Repeat a part at least once";
+					return false;
+				}
+				c = end;
+			}
+
+			if (*c && !isspace(*c) && *c != ',') {
+				error = std::string("Unexpected '") + *c + "'";
+				return false;
+			}
+
+			if (schedule.nPasses + repeats > MAX_SONG_PASSES) {
+				error = "Longer than " + std::to_string(MAX_SONG_PASSES) + " passes";
+				return false;
+			}
+
+			for (int i = 0; i < repeats; i++) {
+				schedule.parts[schedule.nPasses++] = part;
+			}
+
+		}
+
+		return true;
+
+	}
+
+	void setSong(const std::string &source) {
+
+		// Opening the menu sets the text field, which lands here unchanged
+		if (source == songSource && songError.empty()) {
+			return;
+		}
+
+		songSource = source;
+
+		SongSchedule schedule;
+		if (!compileSong(source, schedule, songError)) {
+			return; // Keep playing the last good version
+		}
+		songError.clear();
+
+		if (!songLoads.push(schedule)) {
+			songError = "Busy, edit again to retry";
+		}
+
 	}
 
 	music::RootScaling voltScale = music::RootScaling::CIRCLE;
 
+	music::VoiceLeader voiceLeader;
+	float chordVolts[NUM_PITCHES] = {}; // Chord being played, before and after voice leading
+	float ledVolts[NUM_PITCHES] = {};
+
+	// Voltages of the step being played, taken on the beat from the step prepared a block earlier
+	float playVolts[NUM_PITCHES] = {};
+	int playPart = -1;
+	int playStep = -1;
+
 	bool running = true;
 
 	// for external clock
@@ -130,14 +261,17 @@ struct Progress2 : core::AHModule {
 	rack::dsp::SchmittTrigger resetTrigger;
 	std::array<rack::dsp::SchmittTrigger,8> gateTriggers;
 	rack::dsp::SchmittTrigger copyTrigger;
+	rack::dsp::SchmittTrigger writeTrigger;
 
 	rack::dsp::PulseGenerator gatePulse;
+	bool pulseLight = false;
 
 	/** Phase of internal LFO */
 	float phase = 0.0f;
 
 	// Step index
 	int index = 0;
+	int stepGateChannel = 0; // Channel of the poly step gate that is high
 
 	ProgressState pState;
 
@@ -156,11 +290,83 @@ struct Progress2 : core::AHModule {
 		pState.onReset();
 	}
 
+	// Record a step from the write input. The channels are root (V/oct, or 0V to 6V for the degree when chords come
+	// from the mode), chord (0V to 10V across the chord table), inversion (0V to 2V) and octave (-5V to 5V). Two
+	// more channels optionally address the part (0V to 10V, as the part input) and step (1V per step), otherwise
+	// the step being played is written
+	void writeFromCV() {
+
+		rack::engine::Input &in = inputs[WRITECV_INPUT];
+		int channels = in.getChannels();
+		float v[6] = {};
+		for (int c = 0; c < std::min(channels, 6); c++) {
+			v[c] = in.getVoltage(c);
+		}
+
+		int root;
+		if (pState.chordMode == ChordMode::NORMAL) {
+			root = ((int)roundf(v[0] * 12.0f) % 12 + 12) % 12;
+		} else {
+			root = clamp((int)roundf(v[0]), 0, music::Degrees::NUM_DEGREES - 1);
+		}
+
+		int nChords = music::BasicChordSet.size();
+		int chord = (int)roundf(rescale(clamp(v[1], 0.0f, 10.0f), 0.0f, 10.0f, 0.0f, nChords - 1));
+		int inversion = clamp((int)roundf(v[2]), 0, music::Inversion::NUM_INV - 1);
+		int octave = clamp((int)roundf(v[3]), -5, 5);
+
+		int part = pState.currentPart;
+		if (channels > 4) {
+			part = (int)rescale(clamp(v[4], 0.0f, 10.0f), 0.0f, 10.0f, 0, MAX_PARTS - 1);
+		}
+
+		int step = index;
+		if (channels > 5) {
+			step = (int)fabs(roundf(v[5])) % pState.partLength;
+		}
+
+		pState.writeStep(part, step, root, chord, inversion, octave);
+
+	}
+
+	// The step, and part, expected to play next
+	void predictStep(int &part, int &step) {
+
+		part = pState.currentPart;
+
+		if (inputs[STEP_INPUT].isConnected()) {
+			// The step input is followed every sample, so if it already addresses the step being played, guess
+			// that it is a ramp moving on to the next one
+			step = (int)fabs(roundf(inputs[STEP_INPUT].getVoltage())) % pState.nSteps;
+			if (step != index) {
+				return;
+			}
+		}
+
+		step = index + 1;
+		if (step >= pState.nSteps) {
+			step = 0;
+			if (songMode && song.nPasses) {
+				part = song.parts[(songPass + 1) % song.nPasses];
+			}
+		}
+
+	}
+
 	void setIndex(int index, int nSteps) {
 		phase = 0.0f;
+
+		// The clock wraps by running off the end of the part, the step input by coming back to an earlier step
+		bool wrapped = index < this->index;
+		if (index >= nSteps) {
+			index = 0;
+			wrapped = true;
+		}
 		this->index = index;
-		if (this->index >= nSteps) {
-			this->index = 0;
+
+		// Completed a pass through the part, move along the song
+		if (wrapped && songMode && song.nPasses) {
+			songPass = (songPass + 1) % song.nPasses;
 		}
 		this->gatePulse.trigger(digital::TRIGGER);
 	}
@@ -176,11 +382,17 @@ void Progress2::process(const ProcessArgs &args) {
 		running = !running;
 	}
 
+	// Take up an edited song from its start
+	if (!songLoads.empty()) {
+		while (songLoads.pop(song)) {}
+		songPass = 0;
+	}
+
 	if (copyTrigger.process(params[COPYBTN_PARAM].getValue())) {
 		pState.copyPartFrom(params[COPYSRC_PARAM].getValue());
 	}
 
-	pState.nSteps = static_cast<int>(clamp(roundf(params[STEPS_PARAM].getValue() + inputs[STEPS_INPUT].getVoltage()), 1.0f, 8.0f));
+	pState.nSteps = static_cast<int>(clamp(roundf(params[STEPS_PARAM].getValue() + inputs[STEPS_INPUT].getVoltage()), 1.0f, (float)pState.partLength));
 
 	if (running) {
 		if (inputs[STEP_INPUT].isConnected()) {
@@ -207,6 +419,7 @@ void Progress2::process(const ProcessArgs &args) {
 	// Reset
 	if (resetTrigger.process(params[RESET_PARAM].getValue() + inputs[RESET_INPUT].getVoltage())) {
 		setIndex(0, pState.nSteps);
+		songPass = 0;
 	}
 
 	if (inputs[MODE_INPUT].isConnected()) {
@@ -229,25 +442,47 @@ void Progress2::process(const ProcessArgs &args) {
 		pState.setKey(params[KEY_PARAM].getValue());
 	}
 
-	if (inputs[PART_INPUT].isConnected()) {
+	if (songMode && song.nPasses) {
+		pState.setPart(song.parts[songPass]);
+	} else if (inputs[PART_INPUT].isConnected()) {
 		float pVal = math::clamp(inputs[PART_INPUT].getVoltage(), 0.0f, 10.0f);
 		pState.setPart((int)math::rescale(pVal, 0.0f, 10.0f, 0, 31));
 	} else {
 		pState.setPart(params[PART_PARAM].getValue());
 	}
 
-	// Update
-	pState.update();
+	bool written = false;
+	if (writeTrigger.process(inputs[WRITE_INPUT].getVoltage())) {
+		writeFromCV();
+		written = true;
+	}
 
-	// So, after all that, we calculate the pitch output
-	bool pulse = gatePulse.process(args.sampleTime);
+	// Resolve the step about to be played, catching up on the rest of the part at control rate
+	bool resolved = pState.update(index, controlDue);
 
-	// Gate buttons
-	for (int i = 0; i < 8; i++) {
-		if (gateTriggers[i].process(params[GATE_PARAM + i].getValue())) {
-			pState.toggleGate(pState.currentPart, i);
+	// On the beat, play the step that was prepared for it. Between beats, pick up edits and changes of key or mode
+	if (index != playStep || pState.currentPart != playPart) {
+		if (!pState.takePrepared(pState.currentPart, index, playVolts)) {
+			pState.getChordVoltages(pState.currentPart, index, playVolts);
 		}
+		playPart = pState.currentPart;
+		playStep = index;
+	} else if (resolved || written || controlDue) {
+		pState.getChordVoltages(pState.currentPart, index, playVolts);
+	}
+
+	// Then get the next step ready, a block ahead
+	if (running && controlDue) {
+		int nextPart, nextStep;
+		predictStep(nextPart, nextStep);
+		pState.prepare(nextPart, nextStep);
+	}
+
+	// So, after all that, we calculate the pitch output
+	bool pulse = gatePulse.process(args.sampleTime);
 
+	// Gate outputs are always the first 8 steps, whatever page is on show
+	for (int i = 0; i < PAGE_STEPS; i++) {
 		bool gateOn = (running && i == index && pState.gateState(pState.currentPart, i));
 		if (gateMode == TRIGGER) {
 			gateOn = gateOn && pulse;
@@ -256,26 +491,39 @@ void Progress2::process(const ProcessArgs &args) {
 		}
 
 		outputs[GATE_OUTPUT + i].setVoltage(gateOn ? 10.0f : 0.0f);	
+	}
+
+	// Gate buttons and lights are for the page of the part on show
+	for (int i = 0; i < PAGE_STEPS; i++) {
+		int step = pState.pageStep(i);
+
+		if (gateTriggers[i].process(params[GATE_PARAM + i].getValue())) {
+			pState.toggleGate(pState.currentPart, step);
+		}
 
-		if (i == index) {
-			if (pState.gateState(pState.currentPart, i)) {
+		if (!lightsDue) {
+			continue;
+		}
+
+		if (step == index) {
+			if (pState.gateState(pState.currentPart, step)) {
 				// Gate is on and active = flash green
-				lights[GATE_LIGHTS + i * 2].setSmoothBrightness(1.0f, args.sampleTime);
-				lights[GATE_LIGHTS + i * 2 + 1].setSmoothBrightness(0.0f, args.sampleTime);
+				lights[GATE_LIGHTS + i * 2].setSmoothBrightness(1.0f, lightTime(args.sampleTime));
+				lights[GATE_LIGHTS + i * 2 + 1].setSmoothBrightness(0.0f, lightTime(args.sampleTime));
 			} else {
 				// Gate is off and active = flash dull yellow
-				lights[GATE_LIGHTS + i * 2].setSmoothBrightness(0.20f, args.sampleTime);
-				lights[GATE_LIGHTS + i * 2 + 1].setSmoothBrightness(0.20f, args.sampleTime);
+				lights[GATE_LIGHTS + i * 2].setSmoothBrightness(0.20f, lightTime(args.sampleTime));
+				lights[GATE_LIGHTS + i * 2 + 1].setSmoothBrightness(0.20f, lightTime(args.sampleTime));
 			}
 		} else {
-			if (pState.gateState(pState.currentPart, i)) {
+			if (pState.gateState(pState.currentPart, step)) {
 				// Gate is on and not active = red
-				lights[GATE_LIGHTS + i * 2].setSmoothBrightness(0.0f, args.sampleTime);
-				lights[GATE_LIGHTS + i * 2 + 1].setSmoothBrightness(1.0f, args.sampleTime);
+				lights[GATE_LIGHTS + i * 2].setSmoothBrightness(0.0f, lightTime(args.sampleTime));
+				lights[GATE_LIGHTS + i * 2 + 1].setSmoothBrightness(1.0f, lightTime(args.sampleTime));
 			} else {
 				// Gate is off and not active = black
-				lights[GATE_LIGHTS + i * 2].setSmoothBrightness(0.0f, args.sampleTime);
-				lights[GATE_LIGHTS + i * 2 + 1].setSmoothBrightness(0.0f, args.sampleTime);
+				lights[GATE_LIGHTS + i * 2].setSmoothBrightness(0.0f, lightTime(args.sampleTime));
+				lights[GATE_LIGHTS + i * 2 + 1].setSmoothBrightness(0.0f, lightTime(args.sampleTime));
 			}			
 		}
 	}
@@ -289,14 +537,38 @@ void Progress2::process(const ProcessArgs &args) {
 
 	// Outputs
 	outputs[GATES_OUTPUT].setVoltage(gatesOn ? 10.0f : 0.0f);
-	lights[RUNNING_LIGHT].setBrightness(running);
-	lights[RESET_LIGHT].setSmoothBrightness(resetTrigger.isHigh(), args.sampleTime);
-	lights[COPYBTN_LIGHT].setSmoothBrightness(copyTrigger.isHigh(), args.sampleTime);
-	lights[GATES_LIGHT].setSmoothBrightness(pulse, args.sampleTime);
 
-	// Set the output pitches 
+	// Only the channel of the step being played is high, so just it and the last one are written. A part has up
+	// to 32 steps but a port only 16 channels, so step 17 is on channel 1 again, and so on
+	int channel = index % engine::PORT_MAX_CHANNELS;
+	if (channel != stepGateChannel) {
+		outputs[STEP_GATES_OUTPUT].setVoltage(0.0f, stepGateChannel);
+		stepGateChannel = channel;
+	}
+	outputs[STEP_GATES_OUTPUT].setChannels(std::min(pState.nSteps, engine::PORT_MAX_CHANNELS));
+	outputs[STEP_GATES_OUTPUT].setVoltage(gatesOn ? 10.0f : 0.0f, channel);
+
+	// Hold the gate pulse until the next light update so it is not missed
+	pulseLight = pulseLight || pulse;
+	if (lightsDue) {
+		lights[RUNNING_LIGHT].setBrightness(running);
+		lights[RESET_LIGHT].setSmoothBrightness(resetTrigger.isHigh(), lightTime(args.sampleTime));
+		lights[COPYBTN_LIGHT].setSmoothBrightness(copyTrigger.isHigh(), lightTime(args.sampleTime));
+		lights[GATES_LIGHT].setSmoothBrightness(pulseLight, lightTime(args.sampleTime));
+		pulseLight = false;
+	}
+
+	// Set the output pitches, voice-leading each new chord from the last one
+	float *volts = playVolts;
+	if (voiceLeader.mode != music::VoiceLeader::OFF) {
+		if (memcmp(volts, chordVolts, sizeof(chordVolts))) {
+			memcpy(chordVolts, volts, sizeof(chordVolts));
+			voiceLeader.lead(chordVolts, ledVolts);
+		}
+		volts = ledVolts;
+	}
+
 	outputs[PITCH_OUTPUT].setChannels(6);
-	float *volts = pState.getChordVoltages(pState.currentPart, index);
 	for (int i = 0; i < NUM_PITCHES; i++) {
 		outputs[PITCH_OUTPUT].setVoltage(volts[i], i);
 	}
@@ -309,6 +581,8 @@ struct Progress2Widget : ModuleWidget {
 	std::vector<MenuOption<Progress2::GateMode>> gateOptions;
 	std::vector<MenuOption<ChordMode>> chordOptions;
 	std::vector<MenuOption<music::RootScaling>> scalingOptions;
+	std::vector<MenuOption<music::VoiceLeader::Mode>> voiceOptions;
+	std::vector<MenuOption<int>> lengthOptions;
 
 	Progress2Widget(Progress2 *module) {
 
@@ -342,6 +616,8 @@ struct Progress2Widget : ModuleWidget {
 		addInput(createInputCentered<gui::AHPort>(Vec(171.696, 98.015), module, Progress2::KEY_INPUT));
 		addInput(createInputCentered<gui::AHPort>(Vec(206.696, 98.015), module, Progress2::MODE_INPUT));
 		addInput(createInputCentered<gui::AHPort>(Vec(29.184, 345.74), module, Progress2::STEP_INPUT));
+		addInput(createInputCentered<gui::AHPort>(Vec(324.5, 155.0), module, Progress2::WRITECV_INPUT));
+		addInput(createInputCentered<gui::AHPort>(Vec(324.5, 200.0), module, Progress2::WRITE_INPUT));
 
 		addOutput(createOutputCentered<gui::AHPort>(Vec(277.492, 64.126), module, Progress2::GATES_OUTPUT));
 		addOutput(createOutputCentered<gui::AHPort>(Vec(312.495, 65.18), module, Progress2::PITCH_OUTPUT));
@@ -354,6 +630,7 @@ struct Progress2Widget : ModuleWidget {
 		addOutput(createOutputCentered<gui::AHPort>(Vec(244.414, 345.645), module, Progress2::GATE_OUTPUT + 5));
 		addOutput(createOutputCentered<gui::AHPort>(Vec(279.633, 345.645), module, Progress2::GATE_OUTPUT + 6));
 		addOutput(createOutputCentered<gui::AHPort>(Vec(314.353, 345.645), module, Progress2::GATE_OUTPUT + 7));
+		addOutput(createOutputCentered<gui::AHPort>(Vec(324.5, 275.0), module, Progress2::STEP_GATES_OUTPUT));
 
 		addChild(createLightCentered<SmallLight<GreenLight>>(Vec(265.124, 51.94), module, Progress2::GATES_LIGHT));
 		addChild(createLightCentered<SmallLight<GreenLight>>(Vec(67.49, 57.727), module, Progress2::RUNNING_LIGHT));
@@ -390,6 +667,14 @@ struct Progress2Widget : ModuleWidget {
 		scalingOptions.emplace_back(std::string("V/Oct"), music::RootScaling::VOCT);
 		scalingOptions.emplace_back(std::string("Fourths and Fifths"), music::RootScaling::CIRCLE);
 
+		voiceOptions.emplace_back(std::string("Off"), music::VoiceLeader::OFF);
+		voiceOptions.emplace_back(std::string("Closest to the last chord"), music::VoiceLeader::CLOSEST);
+		voiceOptions.emplace_back(std::string("Closest, within an octave of C4"), music::VoiceLeader::CLOSEST_IN_RANGE);
+
+		lengthOptions.emplace_back(std::string("8 steps"), 8);
+		lengthOptions.emplace_back(std::string("16 steps"), 16);
+		lengthOptions.emplace_back(std::string("32 steps"), 32);
+
 	}
 
 	void appendContextMenu(Menu *menu) override {
@@ -412,16 +697,14 @@ struct Progress2Widget : ModuleWidget {
 		struct OffsetItem : Progress2Menu {
 			int offset;
 			void onAction(const rack::widget::Widget::ActionEvent &e) override {
-				module->pState.offset = offset;
-				module->pState.stateChanged = true;
+				module->pState.postEdit(ProgressEdit(ProgressEdit::OFFSET, 0, 0, offset));
 			}
 		};
 
 		struct ChordModeItem : Progress2Menu {
 			ChordMode chordMode;
 			void onAction(const rack::widget::Widget::ActionEvent &e) override {
-				module->pState.chordMode = chordMode;
-				module->pState.modeChanged = true;
+				module->pState.postEdit(ProgressEdit(ProgressEdit::CHORDMODE, 0, 0, chordMode));
 			}
 		};
 
@@ -464,6 +747,47 @@ struct Progress2Widget : ModuleWidget {
 			}
 		};
 
+		struct VoiceLeadingItem : Progress2Menu {
+			music::VoiceLeader::Mode voiceLeading;
+			void onAction(const rack::widget::Widget::ActionEvent &e) override {
+				module->voiceLeader.mode = voiceLeading;
+			}
+		};
+
+		struct VoiceLeadingMenu : Progress2Menu {
+			Menu *createChildMenu() override {
+				Menu *menu = new Menu;
+				for (auto opt: parent->voiceOptions) {
+					VoiceLeadingItem *item = createMenuItem<VoiceLeadingItem>(opt.name, CHECKMARK(module->voiceLeader.mode == opt.value));
+					item->module = module;
+					item->voiceLeading = opt.value;
+					menu->addChild(item);
+				}
+				return menu;
+			}
+		};
+
+		struct LengthItem : Progress2Menu {
+			int partLength;
+			void onAction(const rack::widget::Widget::ActionEvent &e) override {
+				module->pState.postEdit(ProgressEdit(ProgressEdit::LENGTH, 0, 0, partLength));
+				module->paramQuantities[Progress2::STEPS_PARAM]->setValue(partLength); // Play the whole part
+			}
+		};
+
+		struct LengthMenu : Progress2Menu {
+			Menu *createChildMenu() override {
+				Menu *menu = new Menu;
+				for (auto opt: parent->lengthOptions) {
+					LengthItem *item = createMenuItem<LengthItem>(opt.name, CHECKMARK(module->pState.partLength == opt.value));
+					item->module = module;
+					item->partLength = opt.value;
+					menu->addChild(item);
+				}
+				return menu;
+			}
+		};
+
 		struct ScalingItem : Progress2Menu {
 			music::RootScaling voltScale;
 			void onAction(const rack::widget::Widget::ActionEvent &e) override {
@@ -471,6 +795,44 @@ struct Progress2Widget : ModuleWidget {
 			}
 		};
 
+		struct SongModeItem : Progress2Menu {
+			void onAction(const rack::widget::Widget::ActionEvent &e) override {
+				module->songMode ^= true;
+			}
+		};
+
+		struct SongField : ui::TextField {
+			Progress2 *module;
+			void onChange(const ChangeEvent &e) override {
+				module->setSong(getText());
+			}
+		};
+
+		struct SongMenu : Progress2Menu {
+			Menu *createChildMenu() override {
+				Menu *menu = new Menu;
+
+				SongModeItem *item = createMenuItem<SongModeItem>("Play song", CHECKMARK(module->songMode));
+				item->module = module;
+				menu->addChild(item);
+
+				std::string label = "Parts, each with optional repeats";
+				if (!module->songError.empty()) {
+					label = module->songError;
+				}
+				menu->addChild(createMenuLabel(label));
+
+				SongField *field = new SongField;
+				field->module = module;
+				field->box.size.x = 250;
+				field->placeholder = "e.g. 0x4 1x2 2 0";
+				field->setText(module->songSource);
+				menu->addChild(field);
+
+				return menu;
+			}
+		};
+
 		struct ScalingMenu : Progress2Menu {
 			Menu *createChildMenu() override {
 				Menu *menu = new Menu;
@@ -491,6 +853,11 @@ struct Progress2Widget : ModuleWidget {
 		chordItem->parent = this;
 		menu->addChild(chordItem);
 
+		LengthMenu *lengthItem = createMenuItem<LengthMenu>("Part Length");
+		lengthItem->module = progress;
+		lengthItem->parent = this;
+		menu->addChild(lengthItem);
+
 		GateModeMenu *gateItem = createMenuItem<GateModeMenu>("Gate Mode");
 		gateItem->module = progress;
 		gateItem->parent = this;
@@ -506,6 +873,16 @@ struct Progress2Widget : ModuleWidget {
 		scaleItem->parent = this;
 		menu->addChild(scaleItem);
 
+		VoiceLeadingMenu *voiceItem = createMenuItem<VoiceLeadingMenu>("Voice Leading");
+		voiceItem->module = progress;
+		voiceItem->parent = this;
+		menu->addChild(voiceItem);
+
+		SongMenu *songItem = createMenuItem<SongMenu>("Song");
+		songItem->module = progress;
+		songItem->parent = this;
+		menu->addChild(songItem);
+
 	}
 
 };
@@ -3,160 +3,512 @@
 // ProgressState
 ProgressState::ProgressState() {
 	onReset();
+#ifndef METAMODULE
+	ProgressBuilder::instance().add(this);
+#endif
+}
+
+ProgressState::~ProgressState() {
+#ifndef METAMODULE
+	ProgressBuilder::instance().remove(this);
+#endif
 }
 
 void ProgressState::onReset() {
-	for (int part = 0; part < 32; part++) {
-		for (int step = 0; step < 8; step++) {
-			parts[part][step].reset();
+	for (int part = 0; part < MAX_PARTS; part++) {
+		for (int step = 0; step < MAX_STEPS; step++) {
+			steps[part][step].reset();
 		}
+		markPart(part);
+	}
+	version++;
+}
+
+// PackedStep
+void PackedStep::reset() {
+	note = 0;
+	modeDegree = 0;
+	chord = 0;
+	inversion = 0;
+	octave = 0;
+	gate = true;
+	rootNote = 0;
+	quality = 0;
+}
+
+ProgressChord PackedStep::unpack() const {
+	ProgressChord pChord;
+	pChord.note			= note;
+	pChord.modeDegree	= modeDegree;
+	pChord.chord		= chord;
+	pChord.inversion	= inversion;
+	pChord.octave		= octave;
+	pChord.gate			= gate;
+	pChord.rootNote		= rootNote;
+	pChord.quality		= quality;
+	return pChord;
+}
+// PackedStep
+
+music::KnownChords &ProgressState::knownChords() {
+	static music::KnownChords chords;
+	return chords;
+}
+
+bool ProgressState::postEdit(ProgressEdit e) {
+	return edits.push(e);
+}
+
+// Set one field of the progression, leaving the voltages to the caller
+void ProgressState::setField(const ProgressEdit &e) {
+	PackedStep &pStep = steps[e.part][e.step];
+	switch(e.field) {
+		case ProgressEdit::NOTE:		pStep.note = e.value;						break;
+		case ProgressEdit::DEGREE:		pStep.modeDegree = e.value;					break;
+		case ProgressEdit::CHORD:		pStep.chord = e.value;						break;
+		case ProgressEdit::OCTAVE:		pStep.octave = e.value;						break;
+		case ProgressEdit::INVERSION:	pStep.inversion = e.value;					break;
+		case ProgressEdit::OFFSET:		offset = e.value;							break;
+		case ProgressEdit::CHORDMODE:	chordMode = (ChordMode)e.value;				break;
+		case ProgressEdit::LENGTH:		partLength = e.value;						break;
+	}
+}
+
+// A step has been edited. While the cache is current, only that step is resolved into it and the cache is carried
+// over to the new version, so playback never drops back to resolving steps one at a time. The other buffers no
+// longer match, so are only played once rebuilt for later settings
+void ProgressState::stepChanged(int part, int step) {
+	version++;
+	if (cacheValid) {
+		resolve(part, step);
+		caches[front].settings = currentSettings();
+	} else {
+		dirty[part] |= 1u << step;
 	}
-	stateChanged = true;
 }
 
-void ProgressState::calculateVoltages(int part, int step) {
-	int chordIndex = parts[part][step].chord;
-	int invIndex = parts[part][step].inversion;
+void ProgressState::applyEdits() {
+	ProgressEdit e;
+	while (edits.pop(e)) {
+		setField(e);
 
-	music::ChordDefinition &chordDef = knownChords.chords[chordIndex];
-	std::vector<int> &invDef = chordDef.inversions[invIndex].formula;
-	parts[part][step].setVoltages(invDef, offset);
+		if (e.field == ProgressEdit::OFFSET || e.field == ProgressEdit::CHORDMODE) {
+			markPart(currentPart);
+		} else if (e.field == ProgressEdit::LENGTH) {
+			markPart(currentPart);
+			version++; // The cache only holds the steps in use
+		} else {
+			stepChanged(e.part, e.step);
+		}
+	}
 }
 
-void ProgressState::update() {
-
-	for (int step = 0; step < 8; step++) {
-		if (modeChanged || stateChanged || parts[currentPart][step].dirty) {
-			switch(chordMode) {
-				case ChordMode::NORMAL:
-					parts[currentPart][step].rootNote = parts[currentPart][step].note;
+// Audio thread: record a whole step at once, e.g. from CV. The root is the degree when chords come from the mode
+void ProgressState::writeStep(int part, int step, int root, int chord, int inversion, int octave) {
+	if (chordMode == ChordMode::NORMAL) {
+		setField(ProgressEdit(ProgressEdit::NOTE, part, step, root));
+	} else {
+		setField(ProgressEdit(ProgressEdit::DEGREE, part, step, root));
+	}
+	setField(ProgressEdit(ProgressEdit::CHORD, part, step, chord));
+	setField(ProgressEdit(ProgressEdit::INVERSION, part, step, inversion));
+	setField(ProgressEdit(ProgressEdit::OCTAVE, part, step, octave));
+	stepChanged(part, step);
+}
+
+// Work out the root of a step, and in COERCE mode its chord, for a chord mode, mode and key
+void ProgressState::resolveRoot(ProgressChord &pChord, ChordMode cMode, int m, int k) {
+
+	switch(cMode) {
+		case ChordMode::NORMAL:
+			pChord.rootNote = pChord.note;
+			break;
+		case ChordMode::MODE:
+			music::getRootFromMode(m, k, pChord.modeDegree, &(pChord.rootNote), &(pChord.quality));
+			break;
+		case ChordMode::COERCE:
+			music::getRootFromMode(m, k, pChord.modeDegree, &(pChord.rootNote), &(pChord.quality));
+
+			// Force chord
+			switch(pChord.quality) {
+				case music::Quality::MAJ:
+					pChord.chord = 0;
 					break;
-				case ChordMode::MODE:
-					music::getRootFromMode(mode, key, 
-					parts[currentPart][step].modeDegree,
-					&(parts[currentPart][step].rootNote),
-					&(parts[currentPart][step].quality));
+				case music::Quality::MIN:
+					pChord.chord = 1;
 					break;
-				case ChordMode::COERCE:
-					music::getRootFromMode(mode, key, 
-					parts[currentPart][step].modeDegree,
-					&(parts[currentPart][step].rootNote),
-					&(parts[currentPart][step].quality));
-
-					// Force chord
-					switch(parts[currentPart][step].quality) {
-						case music::Quality::MAJ:
-							parts[currentPart][step].chord = 0;
-							break;
-						case music::Quality::MIN:
-							parts[currentPart][step].chord = 1;
-							break;
-						case music::Quality::DIM:
-							parts[currentPart][step].chord = 54;
-							break;
-					}
+				case music::Quality::DIM:
+					pChord.chord = 54;
+					break;
+			}
+	}
+
+}
+
+// Work out the pitches of a step in semitones. Chord::setVoltages() works in volts, but only ever adds whole
+// semitones and octaves, so they round back exactly
+static void resolvePitches(ProgressChord &pChord, int off, int8_t *semitones) {
+	music::ChordDefinition &chordDef = ProgressState::knownChords().chords[pChord.chord];
+	pChord.setVoltages(chordDef.inversions[pChord.inversion].formula, off);
+	for (int i = 0; i < 6; i++) {
+		semitones[i] = (int8_t)roundf(pChord.outVolts[i] * 12.0f);
+	}
+}
+
+// Resolve a step of the current part into the front cache, which only the audio thread touches. In COERCE mode
+// the chord that was forced is kept
+void ProgressState::resolve(int part, int step) {
+	PackedStep &pStep = steps[part][step];
+	ProgressChord pChord = pStep.unpack();
+	resolveRoot(pChord, chordMode, mode, key);
+	pStep.rootNote = pChord.rootNote;
+	pStep.quality = pChord.quality;
+	pStep.chord = pChord.chord;
+
+	resolvePitches(pChord, offset, caches[front].semitones[part][step]);
+
+	dirty[part] &= ~(1u << step);
+}
+
+// Resolve the step about to be played if it is out of date and there is no cache to play it from. With
+// catchUp, also resolve one other dirty step of the current part, so that the display follows at control rate.
+// Returns true if the step being played has new voltages
+bool ProgressState::update(int step, bool catchUp) {
+
+	// Apply any edits from the UI before the dirty steps are recalculated
+	if (!edits.empty()) {
+		applyEdits();
+	}
+
+	bool swapped = takeCache();
+
+	uint64_t settings = currentSettings();
+	cacheValid = (caches[front].settings == settings);
+	if (!cacheValid) {
+		// Steps resolved into the last front are lost with it
+		if (swapped) {
+			markPart(currentPart);
+		}
+
+#ifndef METAMODULE
+		postRequest(settings);
+#else
+		if (catchUp) {
+			if (request.settings != settings) {
+				fillRequest(settings);
+				buildNextPart = 0;
+			}
+			if (buildNextPart < MAX_PARTS) {
+				buildPart(&caches[back], request, buildNextPart++);
+				if (buildNextPart == MAX_PARTS) {
+					publishCache(settings);
+				}
 			}
+		}
+#endif
+	}
+
+	// Steps past the end of the part are left until the part is lengthened
+	uint32_t d = dirty[currentPart] & lengthMask();
+	if (!d) {
+		return false;
+	}
+
+	bool played = false;
+	if (!cacheValid && (d & (1u << step))) {
+		resolve(currentPart, step);
+		d = dirty[currentPart] & lengthMask();
+		played = true;
+	}
+
+	if (catchUp && d) {
+		resolve(currentPart, __builtin_ctz(d));
+	}
+
+	return played;
+
+}
+
+// Resolve a step ahead of the beat. Without a current cache only the current part is up to date, so a step in
+// another part is left to be resolved when the part is taken up
+void ProgressState::prepare(int part, int step) {
+	if (part != currentPart && !cacheValid) {
+		prepared.part = -1;
+		return;
+	}
+
+	if (!cacheValid && (dirty[part] & (1u << step))) {
+		resolve(part, step);
+	}
+
+	getChordVoltages(part, step, prepared.volts);
+	prepared.part = part;
+	prepared.step = step;
+	prepared.settings = currentSettings();
+}
+
+// The prepared voltages still hold if nothing that goes into them has changed since
+bool ProgressState::takePrepared(int part, int step, float *volts) {
+	if (prepared.part != part || prepared.step != step || prepared.settings != currentSettings()) {
+		return false;
+	}
+
+	memcpy(volts, prepared.volts, sizeof(prepared.volts));
+	return true;
+}
+
+uint64_t ProgressState::currentSettings() {
+	return ((uint64_t)version << 32) | ((uint64_t)(offset & 0xFF) << 16) | ((uint64_t)chordMode << 8) | ((uint64_t)mode << 4) | (uint64_t)key;
+}
+
+// Audio thread: play from the most recently built cache
+bool ProgressState::takeCache() {
+	if (middle.load(std::memory_order_relaxed) & FRESH) {
+		front = middle.exchange(front, std::memory_order_acq_rel) & ~FRESH;
+		return true;
+	}
+	return false;
+}
+
+// Audio thread: copy what a cache for these settings is built from
+void ProgressState::fillRequest(uint64_t settings) {
+	request.settings = settings;
+	request.partLength = partLength;
+	memcpy(request.steps, steps, sizeof(steps));
+}
+
+// Builder: resolve the steps of a part from the request
+void ProgressState::buildPart(VoltageCache *cache, const BuildRequest &req, int part) {
+
+	int k = req.settings & 0xF;
+	int m = (req.settings >> 4) & 0xF;
+	ChordMode cMode = (ChordMode)((req.settings >> 8) & 0xFF);
+	int off = (req.settings >> 16) & 0xFF;
+
+	for (int step = 0; step < req.partLength; step++) {
+		ProgressChord pChord = req.steps[part][step].unpack();
+		resolveRoot(pChord, cMode, m, k);
+		resolvePitches(pChord, off, cache->semitones[part][step]);
+	}
+
+}
+
+// Builder: hand the finished cache to the audio thread and take the one it last released
+void ProgressState::publishCache(uint64_t settings) {
+	caches[back].settings = settings;
+	back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & ~FRESH;
+}
+
+#ifndef METAMODULE
+// Audio thread: ask for a cache for these settings. While the builder is still busy with the last request this is
+// left to the next update
+void ProgressState::postRequest(uint64_t settings) {
+	if (requestPosted.load(std::memory_order_acquire) || request.settings == settings) {
+		return;
+	}
+	fillRequest(settings);
+	requestPosted.store(true, std::memory_order_release);
+	ProgressBuilder::instance().wake();
+}
+
+// Builder: build the cache asked for, if any
+void ProgressState::serveRequest() {
+	if (!requestPosted.load(std::memory_order_acquire)) {
+		return;
+	}
+	for (int part = 0; part < MAX_PARTS; part++) {
+		buildPart(&caches[back], request, part);
+	}
+	publishCache(request.settings);
+	requestPosted.store(false, std::memory_order_release);
+}
+
+// ProgressBuilder
+ProgressBuilder &ProgressBuilder::instance() {
+	static ProgressBuilder builder;
+	return builder;
+}
+
+void ProgressBuilder::add(ProgressState *state) {
+	std::lock_guard<std::mutex> lock(mutex);
+	states.push_back(state);
+
+	if (!running) {
+		running = true;
+		thread = std::thread(&ProgressBuilder::run, this);
+	}
+}
+
+// Waits for a build in progress, so the state is never used once it has gone
+void ProgressBuilder::remove(ProgressState *state) {
+	std::lock_guard<std::mutex> lock(mutex);
+	for (size_t i = 0; i < states.size(); i++) {
+		if (states[i] == state) {
+			states.erase(states.begin() + i);
+			return;
+		}
+	}
+}
+
+void ProgressBuilder::wake() {
+	pending.store(true, std::memory_order_release);
+	wakeup.notify_one();
+}
+
+ProgressBuilder::~ProgressBuilder() {
+	running = false;
+	wakeup.notify_one();
+	if (thread.joinable()) {
+		thread.join();
+	}
+}
 
-			calculateVoltages(currentPart,step);
+void ProgressBuilder::run() {
+	std::unique_lock<std::mutex> lock(mutex);
+	while (running) {
+		pending.exchange(false, std::memory_order_acq_rel);
+		for (ProgressState *state : states) {
+			state->serveRequest();
 		}
-		parts[currentPart][step].dirty = false;
+
+		// The audio thread wakes the builder without taking the mutex, so a wake just before the wait can be
+		// missed. The timeout then picks the request up late, rather than never
+		wakeup.wait_for(lock, std::chrono::milliseconds(100), [this] {
+			return pending.load(std::memory_order_acquire) || !running;
+		});
 	}
-	stateChanged = false;
-	modeChanged = false;
 }
+// ProgressBuilder
+#endif
 
 void ProgressState::copyPartFrom(int src) {
 	if (src == currentPart) {
 		return;
 	}
 
-	for (int step = 0; step < 8; step++) {
-		parts[currentPart][step] = parts[src][step];
-	}
+	memcpy(steps[currentPart], steps[src], sizeof(steps[0]));
 
-	stateChanged = true;
+	markPart(currentPart);
+	version++;
 }
 
 void ProgressState::toggleGate(int part, int step) {
-	parts[part][step].gate = !parts[part][step].gate;
+	steps[part][step].gate ^= 1;
 }
 
 bool ProgressState::gateState(int part, int step) {
-	return parts[part][step].gate;
+	return steps[part][step].gate;
 }
 
-float *ProgressState::getChordVoltages(int part, int step) {
-	return parts[part][step].outVolts;
+void ProgressState::getChordVoltages(int part, int step, float *volts) {
+	int8_t *semitones = caches[front].semitones[part][step];
+	for (int i = 0; i < 6; i++) {
+		volts[i] = semitones[i] * music::SEMITONE;
+	}
 }
 
-ProgressChord *ProgressState::getChord(int part, int step) {
-	return &(parts[part][step]);
+ProgressChord ProgressState::getChord(int part, int step) {
+	return steps[part][step].unpack();
 }
 
 void ProgressState::setMode(int m) {
 	if (mode != m) {
 		mode = m;
-		stateChanged = true;
+		markPart(currentPart);
 	}
 }
 
 void ProgressState::setKey(int k) {
 	if (key != k) {
 		key = k;
-		stateChanged = true;
+		markPart(currentPart);
 	}
 }
 
 void ProgressState::setPart(int p) {
 	if (currentPart != p) {
 		currentPart = p;
-		stateChanged = true;
+		markPart(currentPart);
+	}
+}
+
+// Patch format. Each field of the progression is saved as a hex string with two digits per step, in part then
+// step order. Version 1 has 8 steps per part, version 2 has MAX_STEPS. Patches from before the packed format hold
+// a json_array per field under the same names, with 8 steps per part
+static const int PACKED_VERSION = 2;
+
+enum PackedField {
+	PACKED_ROOTNOTE,
+	PACKED_NOTE,
+	PACKED_QUALITY,
+	PACKED_CHORD,
+	PACKED_MODEDEGREE,
+	PACKED_INVERSION,
+	PACKED_OCTAVE,
+	PACKED_GATE,
+	NUM_PACKED_FIELDS
+};
+
+static const char *const PACKED_NAMES[NUM_PACKED_FIELDS] = {"rootnote", "note", "quality", "chord", "modedegree", "inversion", "octave", "gate"};
+
+static int getPackedField(const PackedStep &pStep, int field) {
+	switch(field) {
+		case PACKED_ROOTNOTE:	return pStep.rootNote;
+		case PACKED_NOTE:		return pStep.note;
+		case PACKED_QUALITY:	return pStep.quality;
+		case PACKED_CHORD:		return pStep.chord;
+		case PACKED_MODEDEGREE:	return pStep.modeDegree;
+		case PACKED_INVERSION:	return pStep.inversion;
+		case PACKED_OCTAVE:		return pStep.octave;
+		default:				return pStep.gate;
+	}
+}
+
+// Values are clamped to what the bit fields and chord table hold, in case of a damaged patch
+static void setPackedField(PackedStep &pStep, int field, int value) {
+	switch(field) {
+		case PACKED_ROOTNOTE:	pStep.rootNote = clamp(value, 0, music::Notes::NUM_NOTES - 1);				break;
+		case PACKED_NOTE:		pStep.note = clamp(value, 0, music::Notes::NUM_NOTES - 1);					break;
+		case PACKED_QUALITY:	pStep.quality = clamp(value, 0, 2);											break;
+		case PACKED_CHORD:		pStep.chord = clamp(value, 0, (int)music::BasicChordSet.size() - 1);		break;
+		case PACKED_MODEDEGREE:	pStep.modeDegree = clamp(value, 0, music::Degrees::NUM_DEGREES - 1);		break;
+		case PACKED_INVERSION:	pStep.inversion = clamp(value, 0, music::Inversion::NUM_INV - 1);			break;
+		case PACKED_OCTAVE:		pStep.octave = clamp(value, -5, 5);											break;
+		default:				pStep.gate = !!value;														break;
 	}
 }
 
+static int hexDigit(char c) {
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	return -1;
+}
+
 json_t *ProgressState::toJson() {
 	json_t *rootJ = json_object();
 
-	// pChord
-	json_t *rootNote_array		= json_array();
-	json_t *note_array			= json_array();
-	json_t *quality_array		= json_array();
-	json_t *chord_array			= json_array();
-	json_t *modeDegree_array	= json_array();
-	json_t *inversion_array		= json_array();
-	json_t *octave_array		= json_array();
-	json_t *gate_array			= json_array();
-
-	for (int part = 0; part < 32; part++) {
-		for (int step = 0; step < 8; step++) {
-			json_t *rootNoteJ	= json_integer(parts[part][step].rootNote);
-			json_t *noteJ		= json_integer(parts[part][step].note);
-			json_t *qualityJ	= json_integer(parts[part][step].quality);
-			json_t *chordJ		= json_integer(parts[part][step].chord);
-			json_t *modeDegreeJ	= json_integer(parts[part][step].modeDegree);
-			json_t *inversionJ	= json_integer(parts[part][step].inversion);
-			json_t *octaveJ		= json_integer(parts[part][step].octave);
-			json_t *gateJ		= json_boolean(parts[part][step].gate);
-
-			json_array_append_new(rootNote_array,	rootNoteJ);
-			json_array_append_new(note_array,		noteJ);
-			json_array_append_new(quality_array,	qualityJ);
-			json_array_append_new(chord_array,		chordJ);
-			json_array_append_new(modeDegree_array,	modeDegreeJ);
-			json_array_append_new(inversion_array,	inversionJ);
-			json_array_append_new(octave_array,		octaveJ);
-			json_array_append_new(gate_array,		gateJ);
+	static const char HEX[] = "0123456789abcdef";
+
+	// pChord, packed
+	json_t *packedJ = json_object();
+	json_object_set_new(packedJ, "version", json_integer(PACKED_VERSION));
+
+	char packed[MAX_PARTS * MAX_STEPS * 2 + 1];
+	for (int field = 0; field < NUM_PACKED_FIELDS; field++) {
+		char *c = packed;
+		for (int part = 0; part < MAX_PARTS; part++) {
+			for (int step = 0; step < MAX_STEPS; step++) {
+				uint8_t value = (uint8_t)getPackedField(steps[part][step], field); // Octaves are stored as signed bytes
+				*c++ = HEX[value >> 4];
+				*c++ = HEX[value & 0xF];
+			}
 		}
+		*c = 0;
+		json_object_set_new(packedJ, PACKED_NAMES[field], json_string(packed));
 	}
 
-	json_object_set_new(rootJ, "rootnote",		rootNote_array);
-	json_object_set_new(rootJ, "note",			note_array);
-	json_object_set_new(rootJ, "quality",		quality_array);
-	json_object_set_new(rootJ, "chord",			chord_array);
-	json_object_set_new(rootJ, "modedegree",	modeDegree_array);
-	json_object_set_new(rootJ, "inversion",		inversion_array);
-	json_object_set_new(rootJ, "octave",		octave_array);
-	json_object_set_new(rootJ, "gate",			gate_array);
+	json_object_set_new(rootJ, "packed", packedJ);
 
 	// offset
 	json_t *offsetJ = json_integer((int) offset);
@@ -166,95 +518,49 @@ json_t *ProgressState::toJson() {
 	json_t *chordModeJ = json_integer((int) chordMode);
 	json_object_set_new(rootJ, "chordMode", chordModeJ);
 
+	// partLength
+	json_object_set_new(rootJ, "partLength", json_integer(partLength));
+
 	return rootJ;
 }
 
 void ProgressState::fromJson(json_t *rootJ) {
 
-	// rootNote
-	json_t *rootNote_array = json_object_get(rootJ, "rootnote");
-	if (rootNote_array) {
-		for (int part = 0; part < 32; part++) {
-			for (int step = 0; step < 8; step++) {
-				json_t *rootNoteJ = json_array_get(rootNote_array, part * 8 + step);
-				if (rootNoteJ) parts[part][step].rootNote = json_integer_value(rootNoteJ);
-			}
-		}
-	}
-
-	// rootNote
-	json_t *note_array = json_object_get(rootJ, "note");
-	if (note_array) {
-		for (int part = 0; part < 32; part++) {
-			for (int step = 0; step < 8; step++) {
-				json_t *noteJ = json_array_get(note_array, part * 8 + step);
-				if (noteJ) parts[part][step].note = json_integer_value(noteJ);
-			}
-		}
-	}
-
-	// quality
-	json_t *quality_array = json_object_get(rootJ, "quality");
-	if (quality_array) {
-		for (int part = 0; part < 32; part++) {
-			for (int step = 0; step < 8; step++) {
-				json_t *qualityJ = json_array_get(quality_array, part * 8 + step);
-				if (qualityJ) parts[part][step].quality = json_integer_value(qualityJ);
-			}
-		}
-	}
-
-	// chord
-	json_t *chord_array = json_object_get(rootJ, "chord");
-	if (chord_array) {
-		for (int part = 0; part < 32; part++) {
-			for (int step = 0; step < 8; step++) {
-				json_t *chordJ = json_array_get(chord_array, part * 8 + step);
-				if (chordJ)	parts[part][step].chord = json_integer_value(chordJ);
-			}
-		}
-	}
-
-	// modeDegree
-	json_t *modeDegree_array = json_object_get(rootJ, "modedegree");
-	if (modeDegree_array) {
-		for (int part = 0; part < 32; part++) {
-			for (int step = 0; step < 8; step++) {
-				json_t *modeDegreeJ = json_array_get(modeDegree_array, part * 8 + step);
-				if (modeDegreeJ) parts[part][step].modeDegree = json_integer_value(modeDegreeJ);
-			}
-		}
-	}
-
-	// inversion
-	json_t *inversion_array = json_object_get(rootJ, "inversion");
-	if (inversion_array) {
-		for (int part = 0; part < 32; part++) {
-			for (int step = 0; step < 8; step++) {
-				json_t *inversionJ = json_array_get(inversion_array, part * 8 + step);
-				if (inversionJ)	parts[part][step].inversion = json_integer_value(inversionJ);
+	// pChord, packed
+	json_t *packedJ = json_object_get(rootJ, "packed");
+	if (packedJ) {
+		json_t *versionJ = json_object_get(packedJ, "version");
+		if (versionJ && json_integer_value(versionJ) <= PACKED_VERSION) {
+			int savedSteps = json_integer_value(versionJ) < 2 ? 8 : MAX_STEPS;
+			for (int field = 0; field < NUM_PACKED_FIELDS; field++) {
+				json_t *fieldJ = json_object_get(packedJ, PACKED_NAMES[field]);
+				if (!fieldJ) continue;
+
+				const char *c = json_string_value(fieldJ);
+				for (int i = 0; c && i < MAX_PARTS * savedSteps; i++, c += 2) {
+					int hi = hexDigit(c[0]);
+					int lo = hi < 0 ? -1 : hexDigit(c[1]);
+					if (lo < 0) break; // Short or damaged string, keep the rest as they are
+					setPackedField(steps[i / savedSteps][i % savedSteps], field, (int8_t)(hi << 4 | lo));
+				}
 			}
 		}
-	}
-
-	// octave
-	json_t *octave_array = json_object_get(rootJ, "octave");
-	if (octave_array) {
-		for (int part = 0; part < 32; part++) {
-			for (int step = 0; step < 8; step++) {
-				json_t *octaveJ = json_array_get(octave_array, part * 8 + step);
-				if (octaveJ) parts[part][step].octave = json_integer_value(octaveJ);
-			}
-		}
-	}
-
-	// gates
-	json_t *gate_array = json_object_get(rootJ, "gate");
-	if (gate_array) {
-		for (int part = 0; part < 32; part++) {
-			for (int step = 0; step < 8; step++) {
-				json_t *gateJ = json_array_get(gate_array, part * 8 + step);
-				if (gateJ) parts[part][step].gate = json_boolean_value(gateJ);
+	} else {
+		// pChord, one array per field
+		for (int field = 0; field < NUM_PACKED_FIELDS; field++) {
+			json_t *fieldArray = json_object_get(rootJ, PACKED_NAMES[field]);
+			if (!fieldArray) continue;
+
+			for (int part = 0; part < MAX_PARTS; part++) {
+				for (int step = 0; step < 8; step++) {
+					json_t *fieldJ = json_array_get(fieldArray, part * 8 + step);
+					if (!fieldJ) continue;
+					if (field == PACKED_GATE) {
+						setPackedField(steps[part][step], field, json_boolean_value(fieldJ));
+					} else {
+						setPackedField(steps[part][step], field, json_integer_value(fieldJ));
+					}
+				}
 			}
 		}
 	}
@@ -267,27 +573,37 @@ void ProgressState::fromJson(json_t *rootJ) {
 	json_t *chordModeJ = json_object_get(rootJ, "chordMode");
 	if (chordModeJ) chordMode = (ChordMode)json_integer_value(chordModeJ);
 
+	// partLength
+	json_t *partLengthJ = json_object_get(rootJ, "partLength");
+	if (partLengthJ) partLength = clamp((int)json_integer_value(partLengthJ), PAGE_STEPS, MAX_STEPS);
+
+	for (int part = 0; part < MAX_PARTS; part++) {
+		markPart(part);
+	}
+	version++;
+
 }
 
 // ProgressState
 
 // Root menu
 void RootItem::onAction(const rack::widget::Widget::ActionEvent &e) {
-	pChord->note = root;
-	pChord->dirty = true;
+	pState->postEdit(ProgressEdit(ProgressEdit::NOTE, part, step, root));
 }
 
 void RootChoice::onAction(const rack::widget::Widget::ActionEvent &e) {
 	if (!pState)
 		return;
 
-	ProgressChord *pChord = pState->getChord(pState->currentPart, pStep);
+	int pStep = pState->pageStep(pRow);
 
 	ui::Menu *menu = createMenu();
 	menu->addChild(createMenuLabel("Root Note"));
 	for (int i = 0; i < music::Notes::NUM_NOTES; i++) {
 		RootItem *item = new RootItem;
-		item->pChord = pChord;
+		item->pState = pState;
+		item->part = pState->currentPart;
+		item->step = pStep;
 		item->root = i;
 		item->text = music::noteNames[i];
 		menu->addChild(item);
@@ -300,7 +616,9 @@ void RootChoice::step() {
 		return;
 	}
 
-	ProgressChord *pC = pState->getChord(pState->currentPart, pStep);
+	int pStep = pState->pageStep(pRow);
+
+	ProgressChord pC = pState->getChord(pState->currentPart, pStep);
 	
 	if(!pState->chordMode && pState->nSteps > pStep) {
 		color = nvgRGBA(0x00, 0xFF, 0xFF, 0xFF);
@@ -308,29 +626,29 @@ void RootChoice::step() {
 		color = nvgRGBA(0x00, 0xFF, 0xFF, 0x6F);
 	}
 
-	text = std::string("◊ ") + music::noteNames[pC->note];
+	text = std::string("◊ ") + music::noteNames[pC.note];
 	
 }
 // Root 
 
 // Degree
 void DegreeItem::onAction(const rack::widget::Widget::ActionEvent &e) {
-	pChord->modeDegree = degree;
-	pChord->dirty = true;
+	pState->postEdit(ProgressEdit(ProgressEdit::DEGREE, part, step, degree));
 }
 
 void DegreeChoice::onAction(const rack::widget::Widget::ActionEvent &e) {
 		if (!pState)
 		return;
 
-	ProgressChord *pChord = pState->getChord(pState->currentPart, pStep);
+	int pStep = pState->pageStep(pRow);
 
 	ui::Menu *menu = createMenu();
 	menu->addChild(createMenuLabel("Degree"));
 	for (int i = 0; i < music::Degrees::NUM_DEGREES; i++) {
 		DegreeItem *item = new DegreeItem;
 		item->pState = pState;
-		item->pChord = pChord;
+		item->part = pState->currentPart;
+		item->step = pStep;
 		item->degree = i;
 		item->text = music::DegreeString[pState->mode][i];
 		menu->addChild(item);
@@ -343,7 +661,9 @@ void DegreeChoice::step() {
 		return;
 	}
 
-	ProgressChord *pC = pState->getChord(pState->currentPart, pStep);
+	int pStep = pState->pageStep(pRow);
+
+	ProgressChord pC = pState->getChord(pState->currentPart, pStep);
 
 	if(pState->chordMode && pState->nSteps > pStep) {
 		color = nvgRGBA(0x00, 0xFF, 0xFF, 0xFF);
@@ -351,25 +671,24 @@ void DegreeChoice::step() {
 		color = nvgRGBA(0x00, 0xFF, 0xFF, 0x6F);
 	}
 
-	text = std::string("◊ ") + music::DegreeString[pState->mode][pC->modeDegree];
+	text = std::string("◊ ") + music::DegreeString[pState->mode][pC.modeDegree];
 
 }
 // Degree
 
 // Chord 
 void ChordItem::onAction(const rack::widget::Widget::ActionEvent &e)  {
-	pChord->chord = chord;
-	pChord->dirty = true;
+	pState->postEdit(ProgressEdit(ProgressEdit::CHORD, part, step, chord));
 }
 
 Menu *ChordSubsetMenu::createChildMenu() {
 
-	ProgressChord *pChord = pState->getChord(pState->currentPart, pStep);
-
 	Menu *menu = new Menu;
 	for (int i = start; i <= end; i++) {
 		ChordItem *item = new ChordItem;
-		item->pChord = pChord;
+		item->pState = pState;
+		item->part = pState->currentPart;
+		item->step = pStep;
 		item->chord = i;
 		item->text = music::BasicChordSet[i].name;
 		menu->addChild(item);
@@ -381,6 +700,8 @@ void ChordChoice::onAction(const rack::widget::Widget::ActionEvent &e) {
 	if (!pState)
 		return;
 
+	int pStep = pState->pageStep(pRow);
+
 	size_t maxChords = music::BasicChordSet.size();
 
 	ui::Menu *menu = createMenu();
@@ -409,8 +730,10 @@ void ChordChoice::step() {
 		return;
 	}
 
-	ProgressChord *pC = pState->getChord(pState->currentPart, pStep);
-	music::InversionDefinition &inv = pState->knownChords.chords[pC->chord].inversions[pC->inversion];
+	int pStep = pState->pageStep(pRow);
+
+	ProgressChord pC = pState->getChord(pState->currentPart, pStep);
+	music::InversionDefinition &inv = ProgressState::knownChords().chords[pC.chord].inversions[pC.inversion];
 
 	if(pState->nSteps > pStep) {
 		color = nvgRGBA(0x00, 0xFF, 0xFF, 0xFF);
@@ -421,9 +744,9 @@ void ChordChoice::step() {
 	text = std::to_string(pStep + 1) + std::string(": ◊ ");
 
 	if (pState->chordMode) {
-		text += inv.getName(pState->mode, pState->key, pC->modeDegree, pC->rootNote);
+		text += inv.getName(pState->mode, pState->key, pC.modeDegree, pC.rootNote);
 	} else {
-		text += inv.getName(pC->rootNote);
+		text += inv.getName(pC.rootNote);
 	}
 
 }
@@ -432,21 +755,22 @@ void ChordChoice::step() {
 
 // Octave
 void OctaveItem::onAction(const rack::widget::Widget::ActionEvent &e) {
-	pChord->octave = octave;
-	pChord->dirty = true;
+	pState->postEdit(ProgressEdit(ProgressEdit::OCTAVE, part, step, octave));
 }
 
 void OctaveChoice::onAction(const rack::widget::Widget::ActionEvent &e) {
 	if (!pState)
 		return;
 
-	ProgressChord *pChord = pState->getChord(pState->currentPart, pStep);
+	int pStep = pState->pageStep(pRow);
 
 	ui::Menu *menu = createMenu();
 	menu->addChild(createMenuLabel("Octave"));
 	for (int i = -5; i < 6; i++) {
 		OctaveItem *item = new OctaveItem;
-		item->pChord = pChord;
+		item->pState = pState;
+		item->part = pState->currentPart;
+		item->step = pStep;
 		item->octave = i;
 		item->text = std::to_string(i);
 		menu->addChild(item);
@@ -459,36 +783,39 @@ void OctaveChoice::step() {
 		return;
 	}
 
+	int pStep = pState->pageStep(pRow);
+
 	if(pState->nSteps > pStep) {
 		color = nvgRGBA(0x00, 0xFF, 0xFF, 0xFF);
 	} else {
 		color = nvgRGBA(0x00, 0xFF, 0xFF, 0x6F);
 	}
 
-	ProgressChord *pChord = pState->getChord(pState->currentPart, pStep);
+	ProgressChord pChord = pState->getChord(pState->currentPart, pStep);
 
-	text = std::string("◊ ") + std::to_string(pChord->octave);
+	text = std::string("◊ ") + std::to_string(pChord.octave);
 
 }
 // Octave 
 
 // Inversion 
 void InversionItem::onAction(const rack::widget::Widget::ActionEvent &e) {
-	pChord->inversion = inversion;
-	pChord->dirty = true;
+	pState->postEdit(ProgressEdit(ProgressEdit::INVERSION, part, step, inversion));
 }
 
 void InversionChoice::onAction(const rack::widget::Widget::ActionEvent &e) {
 	if (!pState)
 		return;
 
-	ProgressChord *pChord = pState->getChord(pState->currentPart, pStep);
+	int pStep = pState->pageStep(pRow);
 
 	ui::Menu *menu = createMenu();
 	menu->addChild(createMenuLabel("Inversion"));
 	for (int i = 0; i < music::Inversion::NUM_INV; i++) {
 		InversionItem *item = new InversionItem;
-		item->pChord = pChord;
+		item->pState = pState;
+		item->part = pState->currentPart;
+		item->step = pStep;
 		item->inversion = i;
 		item->text = music::inversionNames[i];
 		menu->addChild(item);
@@ -501,15 +828,17 @@ void InversionChoice::step() {
 		return;
 	}
 
+	int pStep = pState->pageStep(pRow);
+
 	if(pState->nSteps > pStep) {
 		color = nvgRGBA(0x00, 0xFF, 0xFF, 0xFF);
 	} else {
 		color = nvgRGBA(0x00, 0xFF, 0xFF, 0x6F);
 	}
 
-	ProgressChord *pChord = pState->getChord(pState->currentPart, pStep);
+	ProgressChord pChord = pState->getChord(pState->currentPart, pStep);
 
-	text = std::string("◊ ") + music::inversionNames[pChord->inversion];
+	text = std::string("◊ ") + music::inversionNames[pChord.inversion];
 
 }
 // Inversion 
@@ -530,8 +859,50 @@ void StatusBox::step() {
 
 }
 
+// Page
+void PageItem::onAction(const rack::widget::Widget::ActionEvent &e) {
+	pState->page = page;
+}
+
+void PageChoice::onAction(const rack::widget::Widget::ActionEvent &e) {
+	if (!pState)
+		return;
+
+	ui::Menu *menu = createMenu();
+	menu->addChild(createMenuLabel("Page"));
+	for (int i = 0; i < pState->partLength / PAGE_STEPS; i++) {
+		PageItem *item = createMenuItem<PageItem>("Steps " + std::to_string(i * PAGE_STEPS + 1) + " - " + std::to_string((i + 1) * PAGE_STEPS), CHECKMARK(pState->page == i));
+		item->pState = pState;
+		item->page = i;
+		menu->addChild(item);
+	}
+}
+
+void PageChoice::step() {
+	if (!pState) {
+		text = "";
+		return;
+	}
+
+	// The part may have been shortened since the page was picked
+	int nPages = pState->partLength / PAGE_STEPS;
+	if (pState->page >= nPages) {
+		pState->page = nPages - 1;
+	}
+
+	if(nPages > 1) {
+		color = nvgRGBA(0x00, 0xFF, 0xFF, 0xFF);
+	} else {
+		color = nvgRGBA(0x00, 0xFF, 0xFF, 0x6F);
+	}
+
+	text = "Page " + std::to_string(pState->page + 1) + "/" + std::to_string(nPages);
+
+}
+// Page
+
 // ProgressStepWidget
-void ProgressStepWidget::setPState(ProgressState *pState, int pStep) {
+void ProgressStepWidget::setPState(ProgressState *pState, int pRow) {
 
 	clearChildren();
 
@@ -543,7 +914,7 @@ void ProgressStepWidget::setPState(ProgressState *pState, int pStep) {
 	chordChoice->box.size.x = 155.0;
 	chordChoice->textOffset.y = textOffset;
 	chordChoice->pState = pState;
-	chordChoice->pStep = pStep;
+	chordChoice->pRow = pRow;
 	addChild(chordChoice);
 	pos = chordChoice->box.getTopRight();
 	this->chordChooser = chordChoice;
@@ -552,7 +923,7 @@ void ProgressStepWidget::setPState(ProgressState *pState, int pStep) {
 	rootChoice->box.size.x = 35.0;
 	rootChoice->textOffset.y = textOffset;
 	rootChoice->pState = pState;
-	rootChoice->pStep = pStep;
+	rootChoice->pRow = pRow;
 	addChild(rootChoice);
 	pos = rootChoice->box.getTopRight();
 	this->rootChooser = rootChoice;
@@ -561,7 +932,7 @@ void ProgressStepWidget::setPState(ProgressState *pState, int pStep) {
 	degreeChoice->box.size.x = 30.0;
 	degreeChoice->textOffset.y = textOffset;
 	degreeChoice->pState = pState;
-	degreeChoice->pStep = pStep;
+	degreeChoice->pRow = pRow;
 	addChild(degreeChoice);
 	pos = degreeChoice->box.getTopRight();
 	this->degreeChooser = degreeChoice;
@@ -570,7 +941,7 @@ void ProgressStepWidget::setPState(ProgressState *pState, int pStep) {
 	inversionChoice->box.size.x = 35.0;
 	inversionChoice->textOffset.y = textOffset;
 	inversionChoice->pState = pState;
-	inversionChoice->pStep = pStep;
+	inversionChoice->pRow = pRow;
 	addChild(inversionChoice);
 	pos = inversionChoice->box.getTopRight();
 	this->inversionChooser = inversionChoice;
@@ -579,7 +950,7 @@ void ProgressStepWidget::setPState(ProgressState *pState, int pStep) {
 	octaveChoice->box.size.x = 35.0;
 	octaveChoice->textOffset.y = textOffset;
 	octaveChoice->pState = pState;
-	octaveChoice->pStep = pStep;
+	octaveChoice->pRow = pRow;
 	addChild(octaveChoice);
 	pos = octaveChoice->box.getTopRight();
 	this->octaveChooser = octaveChoice;
@@ -596,9 +967,15 @@ void ProgressStateWidget::setPState(ProgressState *pState) {
 	statusBox->box.size.x = 170.0;
 	statusBox->pState = pState;
 	addChild(statusBox);
+
+	// The rows show one page of the part at a time, so a longer part costs no more to draw
+	PageChoice *pageChoice = createWidget<PageChoice>(statusBox->box.getTopRight());
+	pageChoice->box.size.x = 70.0;
+	pageChoice->pState = pState;
+	addChild(pageChoice);
 	pos = statusBox->box.getBottomLeft();
 
-	for (int i = 0; i < 8; i++) {
+	for (int i = 0; i < PAGE_STEPS; i++) {
 		ProgressStepWidget *pWidget = createWidget<ProgressStepWidget>(pos);
 		pWidget->box.size.x = box.size.x - 5;
 		pWidget->box.size.y = (box.size.y / 9.0) - 2.3;
@@ -2,8 +2,18 @@
 
 #include "AHCommon.hpp"
 
+#ifndef METAMODULE
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
 using namespace ah;
 
+static const int MAX_PARTS = 32;
+static const int MAX_STEPS = 32;
+static const int PAGE_STEPS = 8; // Steps shown, and with buttons, on the panel at a time
+
 enum ChordMode {
 	NORMAL,
 	MODE,
@@ -13,40 +23,121 @@ enum ChordMode {
 struct ProgressChord : music::Chord {
 
 	bool gate;
-	bool dirty;
 	int  note;
 
 	void reset() {
 		music::Chord::reset();
 		gate = true;
-		dirty = true;
 		note = 0;
 	}
 
 };
 
+// A change to the progression made from the UI, applied by the audio thread in ProgressState::update()
+struct ProgressEdit {
+
+	enum Field {
+		NOTE,
+		DEGREE,
+		CHORD,
+		OCTAVE,
+		INVERSION,
+		OFFSET,
+		CHORDMODE,
+		LENGTH
+	};
+
+	ProgressEdit() : field(NOTE), part(0), step(0), value(0) {}
+	ProgressEdit(Field f, int p, int s, int v) : field(f), part(p), step(s), value(v) {}
+
+	Field field;
+	int part;
+	int step;
+	int value;
+
+};
+
+// Resolved pitches for every step of every part, for one set of key, mode, chord mode, offset and chord data.
+// Every voice is a whole number of semitones from 0V, so they are kept as such and turned into volts as played
+struct VoltageCache {
+
+	uint64_t settings = ~0ULL; // Nothing matches until the cache has been built
+	int8_t semitones[MAX_PARTS][MAX_STEPS][6];
+
+};
+
+// One step of the progression in 32 bits, so a part is 128 bytes. The root and quality are filled in from the
+// other fields, the chord mode, mode and key when the step is resolved
+struct PackedStep {
+
+	uint32_t note : 4;
+	uint32_t modeDegree : 3;
+	uint32_t chord : 7;
+	uint32_t inversion : 3;
+	int32_t octave : 4; // -5 to 5
+	uint32_t gate : 1;
+	uint32_t rootNote : 4;
+	uint32_t quality : 2;
+
+	void reset();
+	ProgressChord unpack() const;
+
+};
+
+// The step data a cache is built from. The audio thread copies it out of the progression, so the builder never
+// reads steps that are being changed
+struct BuildRequest {
+	uint64_t settings = ~0ULL;
+	int partLength = PAGE_STEPS;
+	PackedStep steps[MAX_PARTS][MAX_STEPS];
+};
+
 struct ProgressState {
 
 	ChordMode chordMode = ChordMode::NORMAL;  // 0 == Chord, 1 = Mode, 2 = Coerce
 	int offset = 24; 	// Repeated notes in chord and expressed in the chord definition as being transposed 2 octaves lower. 
 						// When played this offset needs to be removed (or the notes removed, or the notes transposed to an octave higher)
 
-	music::KnownChords knownChords;
+	// Shared by every instance, the chord definitions are only read
+	static music::KnownChords &knownChords();
 
-	ProgressChord parts[32][8];
+	PackedStep steps[MAX_PARTS][MAX_STEPS];
 
 	ProgressState();
+	~ProgressState();
 	json_t *toJson();
 	void fromJson(json_t *pStateJ);
 
 	void onReset();
-	void update();
+	bool update(int step, bool catchUp);
+	void resolve(int part, int step);
+	void resolveRoot(ProgressChord &pChord, ChordMode cMode, int m, int k);
+
+	// Called from the UI thread
+	bool postEdit(ProgressEdit e);
+
+	// Edits are applied on the audio thread
+	void applyEdits();
+	void setField(const ProgressEdit &e);
+	void stepChanged(int part, int step);
+	void writeStep(int part, int step, int root, int chord, int inversion, int octave);
 
 	void toggleGate(int part, int step);
 	bool gateState(int part, int step);
-	void calculateVoltages(int part, int step);
-	float *getChordVoltages(int part, int step);
-	ProgressChord *getChord(int part, int step);
+	void getChordVoltages(int part, int step, float *volts);
+
+	// The step expected to play next, resolved a block before the beat so that the beat only copies its voltages
+	struct PreparedStep {
+		int part = -1;
+		int step = -1;
+		uint64_t settings = ~0ULL;
+		float volts[6];
+	};
+	PreparedStep prepared;
+
+	void prepare(int part, int step);
+	bool takePrepared(int part, int step, float *volts);
+	ProgressChord getChord(int part, int step);
 
 	void copyPartFrom(int src);
 
@@ -58,45 +149,133 @@ struct ProgressState {
 	int key = 0;
 	int currentPart = 0;
 	int nSteps = 1;
+	int partLength = PAGE_STEPS; // 8, 16 or 32 steps
+	int page = 0; // Page on show in the UI, set from the UI
 
-	bool stateChanged;
-	bool modeChanged;
+	int pageStep(int row) {
+		return page * PAGE_STEPS + row;
+	}
+
+	// Steps whose voltages are out of date, one bit per step for each part. A change of key, mode or part
+	// marks the whole of the current part; the steps are then resolved as they are played, or in the background
+	static const uint32_t ALL_STEPS = 0xFFFFFFFF;
+	uint32_t dirty[MAX_PARTS];
+
+	uint32_t lengthMask() {
+		return partLength >= MAX_STEPS ? ALL_STEPS : (1u << partLength) - 1;
+	}
+
+	void markPart(int part) {
+		dirty[part] = ALL_STEPS;
+	}
+
+	core::EventQueue<ProgressEdit, 256> edits;
+
+	// Voltage cache, triple-buffered. The audio thread plays from front while the builder fills back from the
+	// request, then swaps it into middle. A part change is then just a different row of front. Any change to the
+	// chord data bumps version, which is part of the settings, so the audio thread falls back to resolving steps
+	// itself, into front, until a cache for the new data arrives
+	VoltageCache caches[3];
+	int front = 0;
+	int back = 1;
+	std::atomic<int> middle {2};
+	static const int FRESH = 4;
+	uint32_t version = 0;
+	bool cacheValid = false;
+
+	// Belongs to the builder while posted, otherwise to the audio thread
+	BuildRequest request;
+
+	uint64_t currentSettings();
+	bool takeCache();
+	void fillRequest(uint64_t settings);
+	void buildPart(VoltageCache *cache, const BuildRequest &req, int part);
+	void publishCache(uint64_t settings);
+
+#ifndef METAMODULE
+	// The cache is built in the background by the ProgressBuilder
+	std::atomic<bool> requestPosted {false};
+	void postRequest(uint64_t settings);
+	void serveRequest();
+#else
+	// No threads, so the cache is built a part at a time on the audio thread at control rate
+	int buildNextPart = MAX_PARTS;
+#endif
 
 };
 
+#ifndef METAMODULE
+
+// One background thread, shared by every Progress2, that builds the voltage caches asked for. It sleeps until an
+// audio thread posts a request
+struct ProgressBuilder {
+
+	static ProgressBuilder &instance();
+
+	void add(ProgressState *state);
+	void remove(ProgressState *state);
+
+	// Audio thread: a request has been posted. Never blocks
+	void wake();
+
+	~ProgressBuilder();
+
+	private:
+
+		void run();
+
+		std::mutex mutex;
+		std::condition_variable wakeup;
+		std::vector<ProgressState *> states;
+		std::thread thread;
+		std::atomic<bool> pending {false};
+		std::atomic<bool> running {false};
+
+};
+
+#endif
+
 // Menu Items
 struct RootItem : ui::MenuItem {
-	ProgressChord *pChord;
+	ProgressState *pState;
+	int part;
+	int step;
 	int root;
 
 	void onAction(const rack::widget::Widget::ActionEvent &e) override;
 };
 
 struct DegreeItem : ui::MenuItem {
-	ProgressChord *pChord;
 	ProgressState *pState;
+	int part;
+	int step;
 	int degree;
 
 	void onAction(const rack::widget::Widget::ActionEvent &e) override;
 };
 
 struct ChordItem : ui::MenuItem {
-	ProgressChord *pChord;
+	ProgressState *pState;
+	int part;
+	int step;
 	int chord;
 
 	void onAction(const rack::widget::Widget::ActionEvent &e) override;
 };
 
 struct OctaveItem : ui::MenuItem {
-	ProgressChord *pChord;
 	ProgressState *pState;
+	int part;
+	int step;
 	int octave;
 
 	void onAction(const rack::widget::Widget::ActionEvent &e) override;
 };
 
 struct InversionItem : ui::MenuItem {
-	ProgressChord *pChord;
+	ProgressState *pState;
+	int part;
+	int step;
 	int inversion;
 
 	void onAction(const rack::widget::Widget::ActionEvent &e) override;
@@ -105,7 +284,7 @@ struct InversionItem : ui::MenuItem {
 // Menus
 struct RootChoice : gui::AHChoice {
 	ProgressState *pState;
-	int pStep;
+	int pRow; // Row on the page
 
 	void onAction(const rack::widget::Widget::ActionEvent &e) override;
 	void step() override;
@@ -113,7 +292,7 @@ struct RootChoice : gui::AHChoice {
 
 struct DegreeChoice : gui::AHChoice {
 	ProgressState *pState;
-	int pStep;
+	int pRow;
 
 	void onAction(const rack::widget::Widget::ActionEvent &e) override;
 	void step() override;
@@ -121,7 +300,7 @@ struct DegreeChoice : gui::AHChoice {
 
 struct ChordChoice : gui::AHChoice {
 	ProgressState *pState;
-	int pStep;
+	int pRow;
 
 	void onAction(const rack::widget::Widget::ActionEvent &e) override;
 	void step() override;
@@ -138,7 +317,7 @@ struct ChordSubsetMenu : MenuItem {
 
 struct OctaveChoice : gui::AHChoice {
 	ProgressState *pState;
-	int pStep;
+	int pRow;
 
 	void onAction(const rack::widget::Widget::ActionEvent &e) override;
 	void step() override;
@@ -146,7 +325,7 @@ struct OctaveChoice : gui::AHChoice {
 
 struct InversionChoice : gui::AHChoice {
 	ProgressState *pState;
-	int pStep;
+	int pRow;
 
 	void onAction(const rack::widget::Widget::ActionEvent &e) override;
 	void step() override;
@@ -158,6 +337,20 @@ struct StatusBox : gui::AHChoice {
 	void step() override;
 };
 
+struct PageItem : ui::MenuItem {
+	ProgressState *pState;
+	int page;
+
+	void onAction(const rack::widget::Widget::ActionEvent &e) override;
+};
+
+struct PageChoice : gui::AHChoice {
+	ProgressState *pState;
+
+	void onAction(const rack::widget::Widget::ActionEvent &e) override;
+	void step() override;
+};
+
 struct ProgressStepWidget : widget::Widget {
 
 	ChordChoice *chordChooser;
@@ -166,11 +359,11 @@ struct ProgressStepWidget : widget::Widget {
 	InversionChoice *inversionChooser;
 	OctaveChoice *octaveChooser;
 
-	void setPState(ProgressState *pState, int pStep);
+	void setPState(ProgressState *pState, int pRow);
 };
 
 struct ProgressStateWidget : widget::Widget {
-	ProgressStepWidget *stepConfig[8];
+	ProgressStepWidget *stepConfig[PAGE_STEPS];
 	ProgressState *pState;	
 
 	void setPState(ProgressState *pState);
@@ -5,6 +5,103 @@
 
 using namespace ah;
 
+// Trigger state for the cells of one Ruckus grid, stored as structure-of-arrays. Grids can be chained into a larger
+// matrix, each grid evaluating its own 4x4 tile against the beat of the left-most grid, which owns the chain. Tiles
+// are laid out in a square, so 4 grids make an 8x8 matrix and 16 grids make a 16x16 matrix, the most there are
+// row and column lines for
+struct RuckusMatrix {
+
+	const static int TILE_SIZE = 4;
+	const static int TILE_CELLS = TILE_SIZE * TILE_SIZE;
+	const static int MAX_TILES = 16;
+	const static int MAX_LINES = 16;
+
+	int tile = 0;
+	int tilesAcross = 1;
+
+	std::array<int,TILE_CELLS> division;
+	std::array<int,TILE_CELLS> shift;
+	std::array<float,TILE_CELLS> prob;
+	std::array<int,TILE_CELLS> state;
+	std::array<int,TILE_CELLS> lightState {}; // Highest state since the last light update
+	std::array<digital::AHPulseGenerator,TILE_CELLS> cellGate;
+
+	// Columns and rows of the full matrix triggered by the last clock, one bit per line
+	uint16_t xTriggered = 0;
+	uint16_t yTriggered = 0;
+
+	// The lines of the full matrix, only run by the owner of the chain
+	std::array<digital::AHPulseGenerator,MAX_LINES> xGate;
+	std::array<digital::AHPulseGenerator,MAX_LINES> yGate;
+
+	static int getTilesAcross(int nTiles) {
+		int across = 1;
+		while (across * across < nTiles) {
+			across++;
+		}
+		return across;
+	}
+
+	// Column and row of a cell in the full matrix
+	inline int getColumn(int cell) {
+		return (tile % tilesAcross) * TILE_SIZE + cell % TILE_SIZE;
+	}
+
+	inline int getRow(int cell) {
+		return (tile / tilesAcross) * TILE_SIZE + cell / TILE_SIZE;
+	}
+
+	void clock(unsigned int beatCounter) {
+
+		xTriggered = 0;
+		yTriggered = 0;
+
+		for (int i = 0; i < TILE_CELLS; i++) {
+
+			if(division[i] == 0) { // 0 == skip
+				continue;
+			}
+
+			int target = beatCounter + shift[i];
+
+			if (target < 0) { // shifted into negative count 
+				continue; 
+			}
+
+			if (target % division[i] == 0) { 
+				if (random::uniform() < prob[i]) {
+					cellGate[i].trigger(digital::TRIGGER);
+					xTriggered |= 1 << getColumn(i);
+					yTriggered |= 1 << getRow(i);
+					state[i] = 2; // Triggered
+				}
+			}
+		}
+	}
+
+};
+
+// Chained grids only talk through Rack's expander messages, so each grid reads and writes nothing but its own
+// ports. The beat goes right from the owner, each tile passing it on, and the lines each tile triggered come back
+// left to the owner. The owner runs the line gates of the full matrix and sends them out with the next beat.
+// A message is cleared once read, so a neighbour that has stopped sending is noticed on the next sample
+struct RuckusBeat {
+	bool valid;
+	int tile;			// Of the grid receiving this, or MAX_TILES when the chain is already full
+	int tilesAcross;
+	unsigned int beatCounter;
+	bool clocked;
+	uint16_t xLines;	// Line gates of the full matrix that are high
+	uint16_t yLines;
+};
+
+struct RuckusTriggers {
+	bool valid;
+	int nTiles;			// Tiles from the sender to the end of the chain
+	uint16_t xLines;	// Lines triggered on this sample by the sender and the tiles beyond it
+	uint16_t yLines;
+};
+
 struct Ruckus : core::AHModule {
 
 	enum ParamIds {
@@ -26,6 +123,7 @@ struct Ruckus : core::AHModule {
 	enum OutputIds {
 		ENUMS(XOUT_OUTPUT,4),
 		ENUMS(YOUT_OUTPUT,4),
+		POLY_OUTPUT,
 		NUM_OUTPUTS
 	};
 	enum LightIds {
@@ -57,12 +155,33 @@ struct Ruckus : core::AHModule {
 			}
 		}
 
+		configOutput(POLY_OUTPUT, "Cell triggers (Poly)");
+
+		leftExpander.producerMessage = &beatMessages[0];
+		leftExpander.consumerMessage = &beatMessages[1];
+		rightExpander.producerMessage = &triggerMessages[0];
+		rightExpander.consumerMessage = &triggerMessages[1];
+
+		// Cell controls are latched at control rate, the clock, reset and mute buttons stay sample-accurate
+		configControlParams(DIV_PARAM, 16);
+		configControlParams(PROB_PARAM, 16);
+		configControlParams(SHIFT_PARAM, 16);
+		configControlInput(POLY_DIV_INPUT);
+		configControlInput(POLY_PROB_INPUT);
+		configControlInput(POLY_SHIFT_INPUT);
+
 		onReset();
 
 	}
 
 	void process(const ProcessArgs &args) override;
 
+	void readTile(bool refresh);
+	void writeTile(uint16_t xLines, uint16_t yLines, float sampleTime);
+
+	// Are we a tile in a grid owned by a Ruckus to our left
+	bool isChainFollower(const RuckusBeat &beat);
+
 	json_t *dataToJson() override {
 		json_t *rootJ = json_object();
 
@@ -81,6 +200,9 @@ struct Ruckus : core::AHModule {
 		json_object_set_new(rootJ, "xMutes", xMutesJ);
 		json_object_set_new(rootJ, "yMutes", yMutesJ);
 
+		// chained
+		json_object_set_new(rootJ, "chained", json_boolean(chained));
+
 		return rootJ;
 	}
 
@@ -101,6 +223,10 @@ struct Ruckus : core::AHModule {
 				if (yMuteJ)	yMute[i] = !!json_integer_value(yMuteJ);
 			}
 		}
+
+		// chained
+		json_t *chainedJ = json_object_get(rootJ, "chained");
+		if (chainedJ) chained = json_boolean_value(chainedJ);
 	}
 
 	void onReset() override {	
@@ -110,9 +236,6 @@ struct Ruckus : core::AHModule {
 		}
 	}
 
-	std::array<digital::AHPulseGenerator,4> xGate;
-	std::array<digital::AHPulseGenerator,4> yGate;
-
 	std::array<bool,4> xMute {{true, true, true, true}};
 	std::array<bool,4> yMute {{true, true, true, true}};
 
@@ -122,21 +245,28 @@ struct Ruckus : core::AHModule {
 	rack::dsp::SchmittTrigger inTrigger;
 	rack::dsp::SchmittTrigger resetTrigger;
 
-	std::array<int,16> division;
-	std::array<int,16> shift;
-	std::array<float,16> prob;
-	std::array<int,16> state;
+	// Join the grid of the Ruckus to our left
+	bool chained = false;
+
+	RuckusMatrix matrix;
+	unsigned int beatCounter = 0; // As the owner of a chain
+
+	// Expander message buffers, the beat from the left and the triggers from the right
+	RuckusBeat beatMessages[2] = {};
+	RuckusTriggers triggerMessages[2] = {};
 
-	unsigned int beatCounter = 0;
+	// Position in the chain, for the menu
+	std::atomic<int> gridTile {0};
 
 };
 
-void Ruckus::process(const ProcessArgs &args) {
+bool Ruckus::isChainFollower(const RuckusBeat &beat) {
+	return chained && beat.valid && beat.tile < RuckusMatrix::MAX_TILES && leftExpander.module && leftExpander.module->model == modelRuckus;
+}
 
-	AHModule::step();
+void Ruckus::readTile(bool refresh) {
 
 	for (int i = 0; i < 4; i++) {
-
 		if (xLockTrigger[i].process(params[XMUTE_PARAM + i].getValue())) {
 			xMute[i] = !xMute[i];
 		}
@@ -146,104 +276,190 @@ void Ruckus::process(const ProcessArgs &args) {
 	}
 
 	for (int i = 0; i < 16; i++) {
-		division[i] = clamp((int)(params[DIV_PARAM + i].getValue() + (inputs[POLY_DIV_INPUT].getVoltage(i) * 6.4f)), 0, 64);
-		prob[i] = clamp(params[PROB_PARAM + i].getValue() + (inputs[POLY_PROB_INPUT].getVoltage(i) * 0.1f), 0.0f, 1.0f);
-		shift[i] = clamp((int)(params[SHIFT_PARAM + i].getValue() + (inputs[POLY_SHIFT_INPUT].getVoltage(i) * 12.8f)), -64, 64);
-	}
-
-	if (resetTrigger.process(inputs[RESET_INPUT].getVoltage())) {
-		beatCounter = 0;
-	}
-
-	for (int y = 0; y < 4; y++) {
-		for (int x = 0; x < 4; x++) {
-			int i = y * 4 + x;
-
-			if (division[i] == 0) {
-				state[i] = 0; // Not active
-			} else {
-				state[i] = 1; // Active
-			}
-
+		if (refresh) {
+			matrix.division[i] = clamp((int)(getControlParam(DIV_PARAM + i) + (getControlInput(POLY_DIV_INPUT, i) * 6.4f)), 0, 64);
+			matrix.prob[i] = clamp(getControlParam(PROB_PARAM + i) + (getControlInput(POLY_PROB_INPUT, i) * 0.1f), 0.0f, 1.0f);
+			matrix.shift[i] = clamp((int)(getControlParam(SHIFT_PARAM + i) + (getControlInput(POLY_SHIFT_INPUT, i) * 12.8f)), -64, 64);
 		}
+		matrix.state[i] = (matrix.division[i] == 0) ? 0 : 1; // Not active or Active
 	}
 
-	if (inTrigger.process(inputs[TRIG_INPUT].getVoltage())) {
-
-		beatCounter++;
+}
 
-		for (int y = 0; y < 4; y++) {
-			for (int x = 0; x < 4; x++) {
-				int i = y * 4 + x;
+void Ruckus::writeTile(uint16_t xLines, uint16_t yLines, float sampleTime) {
 
-				if(division[i] == 0) { // 0 == skip
-					continue;
-				}
+	outputs[POLY_OUTPUT].setChannels(16);
 
-				int target = beatCounter + shift[i];
+	for (int i = 0; i < 16; i++) {
 
-				if (target < 0) { // shifted into negative count 
-					continue; 
-				}
+		outputs[POLY_OUTPUT].setVoltage(matrix.cellGate[i].process(sampleTime) ? 10.0f : 0.0f, i);
 
-				if (target % division[i] == 0) { 
-					if (random::uniform() < prob[i]) {
-						xGate[x].trigger(digital::TRIGGER);
-						yGate[y].trigger(digital::TRIGGER);
-						state[i] = 2; // Triggered
-					}
-				}
-			}
+		// Hold triggers until the next light update so they are not missed
+		matrix.lightState[i] = std::max(matrix.lightState[i], matrix.state[i]);
+		if (!lightsDue) {
+			continue;
 		}
-	}
-
-	for (int y = 0; y < 4; y++) {
-		for (int x = 0; x < 4; x++) {
-			int i = y * 4 + x;
-
-			switch (state[i]) {
-			case 0: 
-				lights[ACTIVE_LIGHT + i].setSmoothBrightness(0.0f, args.sampleTime);
-				lights[TRIG_LIGHT + i].setSmoothBrightness(0.0f, args.sampleTime);
-				break;
-			case 1:
-				lights[ACTIVE_LIGHT + i].setSmoothBrightness(1.0f, args.sampleTime);
-				lights[TRIG_LIGHT + i].setSmoothBrightness(0.0f, args.sampleTime);
-				break;
-			case 2:
-				lights[ACTIVE_LIGHT + i].setSmoothBrightness(1.0f, args.sampleTime);
-				lights[TRIG_LIGHT + i].setSmoothBrightness(1.0f, args.sampleTime);
-				break;
-			default:
-				lights[ACTIVE_LIGHT + i].setSmoothBrightness(0.0f, args.sampleTime);
-				lights[TRIG_LIGHT + i].setSmoothBrightness(0.0f, args.sampleTime);
-			}
 
+		switch (matrix.lightState[i]) {
+		case 0: 
+			lights[ACTIVE_LIGHT + i].setSmoothBrightness(0.0f, lightTime(sampleTime));
+			lights[TRIG_LIGHT + i].setSmoothBrightness(0.0f, lightTime(sampleTime));
+			break;
+		case 1:
+			lights[ACTIVE_LIGHT + i].setSmoothBrightness(1.0f, lightTime(sampleTime));
+			lights[TRIG_LIGHT + i].setSmoothBrightness(0.0f, lightTime(sampleTime));
+			break;
+		case 2:
+			lights[ACTIVE_LIGHT + i].setSmoothBrightness(1.0f, lightTime(sampleTime));
+			lights[TRIG_LIGHT + i].setSmoothBrightness(1.0f, lightTime(sampleTime));
+			break;
+		default:
+			lights[ACTIVE_LIGHT + i].setSmoothBrightness(0.0f, lightTime(sampleTime));
+			lights[TRIG_LIGHT + i].setSmoothBrightness(0.0f, lightTime(sampleTime));
 		}
+		matrix.lightState[i] = 0;
+
 	}
 
+	// The X and Y outputs of a tile carry the columns and rows of the full matrix that pass through it
+	int col = (matrix.tile % matrix.tilesAcross) * RuckusMatrix::TILE_SIZE;
+	int row = (matrix.tile / matrix.tilesAcross) * RuckusMatrix::TILE_SIZE;
+
 	for (int i = 0; i < 4; i++) {
 
-		if (xGate[i].process(args.sampleTime) && xMute[i]) {
+		if ((xLines & (1 << (col + i))) && xMute[i]) {
 			outputs[XOUT_OUTPUT + i].setVoltage(10.0f);		
 		} else {
 			outputs[XOUT_OUTPUT + i].setVoltage(0.0f);		
 		}
 
-		lights[XMUTE_LIGHT + i].setBrightness(xMute[i] ? 1.0 : 0.0);
+		if (lightsDue) {
+			lights[XMUTE_LIGHT + i].setBrightness(xMute[i] ? 1.0 : 0.0);
+		}
 
-		if (yGate[i].process(args.sampleTime) && yMute[i]) {
+		if ((yLines & (1 << (row + i))) && yMute[i]) {
 			outputs[YOUT_OUTPUT + i].setVoltage(10.0f);		
 		} else {
 			outputs[YOUT_OUTPUT + i].setVoltage(0.0f);		
 		}
 
-		lights[YMUTE_LIGHT + i].setBrightness(yMute[i] ? 1.0 : 0.0);
+		if (lightsDue) {
+			lights[YMUTE_LIGHT + i].setBrightness(yMute[i] ? 1.0 : 0.0);
+		}
 
 	}
 
 }
 
+void Ruckus::process(const ProcessArgs &args) {
+
+	AHModule::step();
+
+	// What the grids either side sent on the last sample
+	RuckusBeat *fromLeft = static_cast<RuckusBeat *>(leftExpander.consumerMessage);
+	RuckusTriggers *fromRight = static_cast<RuckusTriggers *>(rightExpander.consumerMessage);
+
+	RuckusBeat beat = *fromLeft;
+	fromLeft->valid = false;
+
+	RuckusTriggers triggers = *fromRight;
+	fromRight->valid = false;
+
+	bool follower = isChainFollower(beat);
+	bool chainFull = chained && beat.valid && beat.tile >= RuckusMatrix::MAX_TILES;
+	if (!triggers.valid) {
+		triggers.nTiles = 0;
+		triggers.xLines = 0;
+		triggers.yLines = 0;
+	}
+
+	if (!follower) {
+
+		// Own the chain, and set the beat for it
+		beat.tile = 0;
+		beat.tilesAcross = RuckusMatrix::getTilesAcross(1 + triggers.nTiles);
+		bool reset = resetTrigger.process(inputs[RESET_INPUT].getVoltage());
+		beat.clocked = inTrigger.process(inputs[TRIG_INPUT].getVoltage());
+
+		if (reset) {
+			beatCounter = 0;
+		}
+		if (beat.clocked) {
+			beatCounter++;
+		}
+		beat.beatCounter = beatCounter;
+
+	}
+
+	// For the menu, MAX_TILES when there was no room left in the chain
+	gridTile.store(chainFull ? RuckusMatrix::MAX_TILES : beat.tile, std::memory_order_relaxed);
+
+	// Cell settings are re-read at control rate, when the tile moves, and on every clock so that the beat always
+	// uses the current controls
+	bool refresh = controlDue || beat.clocked || beat.tile != matrix.tile || beat.tilesAcross != matrix.tilesAcross;
+
+	matrix.tile = beat.tile;
+	matrix.tilesAcross = beat.tilesAcross;
+
+	if (beat.clocked) {
+		latchControls();
+	}
+	readTile(refresh);
+
+	if (beat.clocked) {
+		matrix.clock(beat.beatCounter);
+	}
+
+	uint16_t xLines = matrix.xTriggered | triggers.xLines;
+	uint16_t yLines = matrix.yTriggered | triggers.yLines;
+	matrix.xTriggered = 0;
+	matrix.yTriggered = 0;
+
+	if (follower) {
+
+		// Pass the lines triggered here and beyond back towards the owner
+		RuckusTriggers *toLeft = static_cast<RuckusTriggers *>(leftExpander.module->rightExpander.producerMessage);
+		toLeft->valid = true;
+		toLeft->nTiles = 1 + triggers.nTiles;
+		toLeft->xLines = xLines;
+		toLeft->yLines = yLines;
+		leftExpander.module->rightExpander.messageFlipRequested = true;
+
+	} else {
+
+		// Run the lines of the full matrix, which go out with the beat
+		beat.xLines = 0;
+		beat.yLines = 0;
+		for (int i = 0; i < RuckusMatrix::MAX_LINES; i++) {
+			if (xLines & (1 << i)) {
+				matrix.xGate[i].trigger(digital::TRIGGER);
+			}
+			if (yLines & (1 << i)) {
+				matrix.yGate[i].trigger(digital::TRIGGER);
+			}
+			if (matrix.xGate[i].process(args.sampleTime)) {
+				beat.xLines |= 1 << i;
+			}
+			if (matrix.yGate[i].process(args.sampleTime)) {
+				beat.yLines |= 1 << i;
+			}
+		}
+
+	}
+
+	// Pass the beat on to the right. A Ruckus there only follows it if it is chained
+	if (rightExpander.module && rightExpander.module->model == modelRuckus) {
+		RuckusBeat *toRight = static_cast<RuckusBeat *>(rightExpander.module->leftExpander.producerMessage);
+		*toRight = beat;
+		toRight->valid = true;
+		toRight->tile = std::min(beat.tile + 1, (int)RuckusMatrix::MAX_TILES);
+		rightExpander.module->leftExpander.messageFlipRequested = true;
+	}
+
+	writeTile(beat.xLines, beat.yLines, args.sampleTime);
+
+}
+
 struct RuckusWidget : ModuleWidget {
 
 	RuckusWidget(Ruckus *module) {
@@ -328,6 +544,8 @@ struct RuckusWidget : ModuleWidget {
 		addOutput(createOutputCentered<gui::AHPort>(Vec(172.738, 332.826), module, Ruckus::XOUT_OUTPUT + 2));
 		addOutput(createOutputCentered<gui::AHPort>(Vec(242.738, 332.826), module, Ruckus::XOUT_OUTPUT + 3));
 
+		addOutput(createOutputCentered<gui::AHPort>(Vec(320.981, 332.826), module, Ruckus::POLY_OUTPUT));
+
 		addChild(createLightCentered<SmallLight<RedLight>>(Vec(52.579, 30.329), module, Ruckus::TRIG_LIGHT + 0));
 		addChild(createLightCentered<SmallLight<RedLight>>(Vec(122.579, 30.329), module, Ruckus::TRIG_LIGHT + 1));
 		addChild(createLightCentered<SmallLight<RedLight>>(Vec(192.579, 30.329), module, Ruckus::TRIG_LIGHT + 2));
@@ -373,6 +591,35 @@ struct RuckusWidget : ModuleWidget {
 		addChild(createLightCentered<SmallLight<GreenLight>>(Vec(290.804, 251.683), module, Ruckus::YMUTE_LIGHT + 3));
 
 	}
+
+	void appendContextMenu(Menu *menu) override {
+
+		Ruckus *ruckus = dynamic_cast<Ruckus*>(module);
+		assert(ruckus);
+
+		struct ChainItem : MenuItem {
+			Ruckus *module;
+			void onAction(const rack::widget::Widget::ActionEvent &e) override {
+				module->chained = !module->chained;
+			}
+		};
+
+		menu->addChild(construct<MenuLabel>());
+		ChainItem *item = createMenuItem<ChainItem>("Chain to Ruckus on left", CHECKMARK(ruckus->chained));
+		item->module = ruckus;
+		menu->addChild(item);
+
+		if (ruckus->chained) {
+			int tile = ruckus->gridTile.load(std::memory_order_relaxed);
+			if (tile >= RuckusMatrix::MAX_TILES) {
+				menu->addChild(createMenuLabel("Chain is full at " + std::to_string(RuckusMatrix::MAX_TILES) + " grids, running alone"));
+			} else {
+				menu->addChild(createMenuLabel("Grid " + std::to_string(tile + 1) + " of the chain"));
+			}
+		}
+
+	}
+
 };
 
 Model *modelRuckus = createModel<Ruckus, RuckusWidget>("Ruckus");
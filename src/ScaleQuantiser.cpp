@@ -35,8 +35,6 @@ struct ScaleQuantizer : core::AHModule {
 	void process(const ProcessArgs &args) override;
 
 	bool firstStep = true;
-	int lastScale = 0;
-	int lastRoot = 0;
 	float lastPitch = 0.0;
 	
 	int currScale = 0;
@@ -48,9 +46,9 @@ struct ScaleQuantizer : core::AHModule {
 };
 
 void ScaleQuantizer::process(const ProcessArgs &args) {
+
+	AHModule::step();
 	
-	lastScale = currScale;
-	lastRoot = currRoot;
 	lastPitch = currPitch;
 
 	// Get the input pitch
@@ -64,33 +62,35 @@ void ScaleQuantizer::process(const ProcessArgs &args) {
 	// Set the value
 	outputs[OUT_OUTPUT].setVoltage(currPitch);
 
-	// update tone lights
-	for (int i = 0; i < music::Notes::NUM_NOTES; i++) {
-		lights[NOTE_LIGHT + i].value = 0.0;
-	}
-	lights[NOTE_LIGHT + currNote].value = 1.0;
-
-	// update degree lights
+	// update degree gates
 	for (int i = 0; i < music::Notes::NUM_NOTES; i++) {
-		lights[DEGREE_LIGHT + i].value = 0.0;
 		outputs[GATE_OUTPUT + i].setVoltage(0.0);
 	}
-	lights[DEGREE_LIGHT + currInterval].value = 1.0;
 	outputs[GATE_OUTPUT + currInterval].setVoltage(10.0);
 
-	if (lastScale != currScale || firstStep) {
-		for (int i = 0; i <music::Notes::NUM_NOTES; i++) {
-			lights[SCALE_LIGHT + i].value = 0.0;
+	if (lightsDue) {
+
+		// update tone lights
+		for (int i = 0; i < music::Notes::NUM_NOTES; i++) {
+			lights[NOTE_LIGHT + i].value = 0.0;
 		}
-		lights[SCALE_LIGHT + currScale].value = 1.0;
-	} 
+		lights[NOTE_LIGHT + currNote].value = 1.0;
 
-	if (lastRoot != currRoot || firstStep) {
+		// update degree lights
 		for (int i = 0; i < music::Notes::NUM_NOTES; i++) {
+			lights[DEGREE_LIGHT + i].value = 0.0;
+		}
+		lights[DEGREE_LIGHT + currInterval].value = 1.0;
+
+		// update scale and key lights
+		for (int i = 0; i < music::Notes::NUM_NOTES; i++) {
+			lights[SCALE_LIGHT + i].value = 0.0;
 			lights[KEY_LIGHT + i].value = 0.0;
 		}
+		lights[SCALE_LIGHT + currScale].value = 1.0;
 		lights[KEY_LIGHT + currRoot].value = 1.0;
-	} 
+
+	}
 
 	if (lastPitch != currPitch || firstStep) {
 		outputs[TRIG_OUTPUT].setVoltage(10.0);
@@ -45,6 +45,15 @@ struct ScaleQuantizer2 : core::AHModule {
 			configParam(SHIFT_PARAM + i, -3.0f, 3.0f, 0.0f, "Octave shift", " octaves");
 		}
 
+		// Key, scale and shifts are latched at control rate, the pitch and hold inputs stay sample-accurate
+		configControlParam(KEY_PARAM);
+		configControlParam(SCALE_PARAM);
+		configControlParam(TRANS_PARAM);
+		configControlParams(SHIFT_PARAM, 8);
+		configControlInput(KEY_INPUT);
+		configControlInput(SCALE_INPUT);
+		configControlInput(TRANS_INPUT);
+
 	}
 
 	json_t *dataToJson() override {
@@ -67,10 +76,8 @@ struct ScaleQuantizer2 : core::AHModule {
 
 	music::RootScaling voltScale = music::RootScaling::CIRCLE;
 
-	bool firstStep = true;
-	int lastScale = 0;
-	int lastRoot = 0;
 	float lastTrans = -10000.0f;
+	float currTrans = 0.0f;
 
 	dsp::SchmittTrigger holdTrigger[8][16];
 	dsp::PulseGenerator triggerPulse[8][16];
@@ -89,39 +96,41 @@ void ScaleQuantizer2::process(const ProcessArgs &args) {
 
 	AHModule::step();
 
-	lastScale = currScale;
-	lastRoot = currRoot;
+	// Key, scale and transposition only change when the controls have been re-sampled
+	if (controlDue) {
 
-	if (inputs[KEY_INPUT].isConnected()) {
-		float v = inputs[KEY_INPUT].getVoltage();
-		if (voltScale == music::RootScaling::CIRCLE) {
-			currRoot = music::getKeyFromVolts(v);
+		if (isControlConnected(KEY_INPUT)) {
+			float v = getControlInput(KEY_INPUT);
+			if (voltScale == music::RootScaling::CIRCLE) {
+				currRoot = music::getKeyFromVolts(v);
+			} else {
+				int intv;
+				music::getPitchFromVolts(v, music::Notes::NOTE_C, music::Scales::SCALE_CHROMATIC, &currRoot, &intv);
+			}
 		} else {
-			int intv;
-			music::getPitchFromVolts(v, music::Notes::NOTE_C, music::Scales::SCALE_CHROMATIC, &currRoot, &intv);
+			currRoot = getControlParam(KEY_PARAM);
 		}
-	} else {
-		currRoot = params[KEY_PARAM].getValue();
-	}
 
-	if (inputs[SCALE_INPUT].isConnected()) {
-		currScale = music::getScaleFromVolts(inputs[SCALE_INPUT].getVoltage());
-	} else {
-		currScale = params[SCALE_PARAM].getValue();
-	}
-
-	float trans = (inputs[TRANS_INPUT].getVoltage() + params[TRANS_PARAM].getValue()) / 12.0;
-	if (trans != 0.0) {
-		if (trans != lastTrans) {
-			trans = music::getPitchFromVolts(trans, music::Notes::NOTE_C, music::Scales::SCALE_CHROMATIC);
-			lastTrans = trans;
+		if (isControlConnected(SCALE_INPUT)) {
+			currScale = music::getScaleFromVolts(getControlInput(SCALE_INPUT));
 		} else {
-			trans = lastTrans;
+			currScale = getControlParam(SCALE_PARAM);
+		}
+
+		currTrans = (getControlInput(TRANS_INPUT) + getControlParam(TRANS_PARAM)) / 12.0;
+		if (currTrans != 0.0) {
+			if (currTrans != lastTrans) {
+				currTrans = music::getPitchFromVolts(currTrans, music::Notes::NOTE_C, music::Scales::SCALE_CHROMATIC);
+				lastTrans = currTrans;
+			} else {
+				currTrans = lastTrans;
+			}
 		}
+
 	}
 
 	for (int i = 0; i < 8; i++) {
-		float shift			= params[SHIFT_PARAM + i].getValue();
+		float shift			= getControlParam(SHIFT_PARAM + i);
 		int nCVChannels		= inputs[IN_INPUT + i].getChannels();
 		int nHoldChannels	= inputs[HOLD_INPUT + i].getChannels();
 		int nChannels		= std::max(nCVChannels,nHoldChannels);
@@ -161,7 +170,7 @@ void ScaleQuantizer2::process(const ProcessArgs &args) {
 				triggerPulse[i][j].trigger(digital::TRIGGER);
 			} 
 
-			outputs[OUT_OUTPUT + i].setVoltage(holdPitch[i][j] + shift + trans, j);
+			outputs[OUT_OUTPUT + i].setVoltage(holdPitch[i][j] + shift + currTrans, j);
 
 			if (triggerPulse[i][j].process(args.sampleTime)) {
 				outputs[TRIG_OUTPUT + i].setVoltage(10.0f, j);
@@ -173,22 +182,15 @@ void ScaleQuantizer2::process(const ProcessArgs &args) {
 
 	}
 
-	if (lastScale != currScale || firstStep) {
+	if (lightsDue) {
 		for (int i = 0; i < music::Notes::NUM_NOTES; i++) {
 			lights[SCALE_LIGHT + i].setBrightness(0.0f);
-		}
-		lights[SCALE_LIGHT + currScale].setBrightness(10.0f);
-	} 
-
-	if (lastRoot != currRoot || firstStep) {
-		for (int i = 0; i < music::Notes::NUM_NOTES; i++) {
 			lights[KEY_LIGHT + i].setBrightness(0.0f);
 		}
+		lights[SCALE_LIGHT + currScale].setBrightness(10.0f);
 		lights[KEY_LIGHT + currRoot].setBrightness(10.0f);
 	} 
 
-	firstStep = false;
-
 }
 
 struct ScaleQuantizer2Widget : ModuleWidget {
@@ -0,0 +1,172 @@
+// Arp31 must not touch the heap once it is running. Global operator new is replaced with one that counts its
+// calls, the pattern table is built up front, and then every pattern is started, played and randomised with
+// counting on. A module is then run through process() with poly pitches, gates and clocks connected, across
+// cycle restarts, chord banks and lanes. Any allocation fails the test
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+static bool counting = false;
+static long allocations = 0;
+
+void *operator new(std::size_t size) {
+	if (counting) {
+		allocations++;
+	}
+	void *p = std::malloc(size ? size : 1);
+	if (!p) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void operator delete(void *p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+	std::free(p);
+}
+
+#include "../src/Arp31c.cpp"
+
+Plugin *pluginInstance;
+
+// Run the module for a number of clock ticks, a tick being high for 10 samples and low for 10
+static void run(Arp31 *module, int ticks) {
+	Module::ProcessArgs args;
+	args.sampleRate = 44100.0f;
+	args.sampleTime = 1.0f / args.sampleRate;
+	args.frame = 0;
+	Input &clock = module->inputs[Arp31::CLOCK_INPUT];
+	for (int t = 0; t < ticks; t++) {
+		for (int s = 0; s < 20; s++) {
+			float v = (s < 10) ? 10.0f : 0.0f;
+			for (int c = 0; c < std::max(clock.getChannels(), 1); c++) {
+				clock.setVoltage(v, c);
+			}
+			module->process(args);
+			args.frame++;
+		}
+	}
+}
+
+static void trigger(Arp31 *module, int input) {
+	module->inputs[input].setVoltage(10.0f);
+	run(module, 1);
+	module->inputs[input].setVoltage(0.0f);
+}
+
+int main() {
+
+	// Built once when the first module is created, so allowed to allocate
+	ArpPatternTable &table = ArpPatternTable::instance();
+	RightArp2 arp;
+	Arp31Lanes *lanes = new Arp31Lanes;
+	core::FixedVector<float, engine::PORT_MAX_CHANNELS> chord;
+
+	counting = true;
+
+	for (unsigned int a = 0; a < ArpPatternTable::NUM_ARPS; a++) {
+		for (unsigned int n = 1; n <= ArpPatternTable::MAX_PITCHES; n++) {
+			for (int r = 0; r < 2; r++) {
+
+				const Arpeggio2::IndexList &pattern = table.get(a, n, r);
+
+				// A cycle, as Arp31 plays it
+				arp.initialise(pattern, n / 2, r);
+				while (!arp.isArpeggioFinished()) {
+					arp.getPitch();
+					arp.advance();
+				}
+				arp.randomize();
+				arp.randomize();
+				arp.reset();
+
+				// And as a lane of the poly clock
+				int l = (a * ArpPatternTable::MAX_PITCHES + n) % Arp31Lanes::MAX_LANES;
+				lanes->initialise(l, pattern, n / 2);
+				lanes->randomize(l);
+
+				// Chords are read into fixed vectors
+				chord.clear();
+				for (unsigned int i = 0; i < n; i++) {
+					chord.push_back(i * music::SEMITONE);
+				}
+
+			}
+		}
+	}
+
+	counting = false;
+
+	delete lanes;
+
+	// Now the module itself. Everything it owns is built in the constructor
+	Arp31 *module = new Arp31;
+	Input *inputs = module->inputs.data();
+
+	inputs[Arp31::PITCH_INPUT].setChannels(6);
+	inputs[Arp31::GATE_INPUT].setChannels(6);
+	inputs[Arp31::CLOCK_INPUT].setChannels(1);
+	inputs[Arp31::CAPTURE_INPUT].setChannels(1);
+	inputs[Arp31::RANDOM_INPUT].setChannels(1);
+	for (int c = 0; c < 6; c++) {
+		inputs[Arp31::PITCH_INPUT].setVoltage(c * 4 * music::SEMITONE, c);
+		inputs[Arp31::GATE_INPUT].setVoltage(10.0f, c);
+	}
+
+	// Warm up, past the first few steps the module skips
+	run(module, 4);
+
+	counting = true;
+
+	// Restarting every cycle reads the chord from the poly inputs, changing size as gates close
+	for (int a = 0; a < 8; a++) {
+		module->params[Arp31::ARP_PARAM].setValue(a);
+		inputs[Arp31::GATE_INPUT].setVoltage(a % 2 ? 0.0f : 10.0f, a % 6);
+		run(module, 40);
+		trigger(module, Arp31::RANDOM_INPUT);
+	}
+
+	// Capture the inputs into the banks in turn, then select each bank from the bank input
+	for (int b = 0; b < Arp31::NUM_BANKS; b++) {
+		inputs[Arp31::PITCH_INPUT].setVoltage(b * music::SEMITONE, 0);
+		trigger(module, Arp31::CAPTURE_INPUT);
+	}
+	inputs[Arp31::BANK_INPUT].setChannels(1);
+	for (int b = 0; b <= Arp31::NUM_BANKS; b++) {
+		inputs[Arp31::BANK_INPUT].setVoltage(b);
+		run(module, 20);
+		trigger(module, Arp31::CAPTURE_INPUT);
+	}
+	inputs[Arp31::BANK_INPUT].setChannels(0);
+
+	// A lane per clock channel, with and without the chord split between them
+	module->polyClock = true;
+	inputs[Arp31::CLOCK_INPUT].setChannels(4);
+	for (int split = 0; split < 2; split++) {
+		module->splitChord = split;
+		for (int a = 0; a < 8; a++) {
+			module->params[Arp31::ARP_PARAM].setValue(a);
+			run(module, 30);
+			trigger(module, Arp31::RANDOM_INPUT);
+		}
+	}
+	inputs[Arp31::BANK_INPUT].setChannels(1);
+	inputs[Arp31::BANK_INPUT].setVoltage(3.0f);
+	run(module, 30);
+
+	counting = false;
+
+	delete module;
+
+	if (allocations) {
+		printf("Arp31c: %ld allocations while playing\n", allocations);
+		return 1;
+	}
+
+	printf("Arp31c: no allocations while playing\n");
+	return 0;
+
+}
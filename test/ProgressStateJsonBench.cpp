@@ -0,0 +1,144 @@
+// Save and load times of a full progression in the array format patches were saved in before the packed format,
+// against the packed format saved now. Every part and step is filled with different values, the patch is written
+// in the array format, loaded, saved packed and loaded again. Any field that does not survive fails the test
+#include <chrono>
+#include <cstdio>
+
+#include "../src/ProgressState.cpp"
+
+Plugin *pluginInstance;
+
+static const int ITERATIONS = 200;
+static const int V1_STEPS = 8;
+
+// Every field of a step, in range of what it holds
+static int testValue(int part, int step, int field) {
+	int n = part * MAX_STEPS + step + field * 7;
+	switch(field) {
+		case PACKED_ROOTNOTE:	return n % music::Notes::NUM_NOTES;
+		case PACKED_NOTE:		return (n * 5) % music::Notes::NUM_NOTES;
+		case PACKED_QUALITY:	return n % 3;
+		case PACKED_CHORD:		return n % (int)music::BasicChordSet.size();
+		case PACKED_MODEDEGREE:	return n % music::Degrees::NUM_DEGREES;
+		case PACKED_INVERSION:	return n % music::Inversion::NUM_INV;
+		case PACKED_OCTAVE:		return n % 11 - 5;
+		default:				return n % 2;
+	}
+}
+
+// As ProgressState::toJson wrote patches before the packed format, one array per field of 8 steps per part
+static json_t *toJsonV1(ProgressState &pState) {
+	json_t *rootJ = json_object();
+
+	for (int field = 0; field < NUM_PACKED_FIELDS; field++) {
+		json_t *fieldArray = json_array();
+		for (int part = 0; part < MAX_PARTS; part++) {
+			for (int step = 0; step < V1_STEPS; step++) {
+				int value = getPackedField(pState.steps[part][step], field);
+				json_array_append_new(fieldArray, field == PACKED_GATE ? json_boolean(value) : json_integer(value));
+			}
+		}
+		json_object_set_new(rootJ, PACKED_NAMES[field], fieldArray);
+	}
+
+	json_object_set_new(rootJ, "offset", json_integer((int) pState.offset));
+	json_object_set_new(rootJ, "chordMode", json_integer((int) pState.chordMode));
+
+	return rootJ;
+}
+
+// Microseconds per call of f
+template <typename F>
+static double timeOf(F f) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < ITERATIONS; i++) {
+		f();
+	}
+	std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+	return elapsed.count() / ITERATIONS;
+}
+
+int main() {
+
+	ProgressState *source = new ProgressState;
+	for (int part = 0; part < MAX_PARTS; part++) {
+		for (int step = 0; step < MAX_STEPS; step++) {
+			for (int field = 0; field < NUM_PACKED_FIELDS; field++) {
+				setPackedField(source->steps[part][step], field, testValue(part, step, field));
+			}
+		}
+	}
+
+	// Round trip, array format to packed and back
+	json_t *v1J = toJsonV1(*source);
+	ProgressState *fromV1 = new ProgressState;
+	fromV1->fromJson(v1J);
+	json_decref(v1J);
+
+	json_t *v2J = fromV1->toJson();
+	ProgressState *fromV2 = new ProgressState;
+	fromV2->fromJson(v2J);
+	json_decref(v2J);
+
+	int errors = 0;
+	for (int part = 0; part < MAX_PARTS; part++) {
+		for (int step = 0; step < MAX_STEPS; step++) {
+			for (int field = 0; field < NUM_PACKED_FIELDS; field++) {
+				int v2 = getPackedField(fromV2->steps[part][step], field);
+				if (v2 != getPackedField(fromV1->steps[part][step], field) ||
+					(step < V1_STEPS && v2 != testValue(part, step, field))) {
+					if (errors++ < 10) {
+						printf("ProgressState: part %d step %d %s is %d, saved as %d\n",
+							part, step, PACKED_NAMES[field], v2, testValue(part, step, field));
+					}
+				}
+			}
+		}
+	}
+	if (fromV2->offset != source->offset || fromV2->chordMode != source->chordMode) {
+		printf("ProgressState: offset or chord mode lost\n");
+		errors++;
+	}
+
+	// Save and load, both formats
+	ProgressState *target = new ProgressState;
+
+	double v1Save = timeOf([&]() {
+		json_decref(toJsonV1(*source));
+	});
+	v1J = toJsonV1(*source);
+	double v1Load = timeOf([&]() {
+		target->fromJson(v1J);
+	});
+	json_decref(v1J);
+
+	double v2Save = timeOf([&]() {
+		json_decref(source->toJson());
+	});
+	v2J = source->toJson();
+	double v2Load = timeOf([&]() {
+		target->fromJson(v2J);
+	});
+	json_decref(v2J);
+
+	// The packed format holds four times the steps, so the time per step is shown as well
+	double v1Steps = MAX_PARTS * V1_STEPS;
+	double v2Steps = MAX_PARTS * MAX_STEPS;
+	printf("ProgressState: %d parts, save/load in us, then in ns per step\n", MAX_PARTS);
+	printf("  arrays (v1, %2d steps) %8.1f %8.1f %8.1f %8.1f\n", V1_STEPS, v1Save, v1Load, v1Save * 1000.0 / v1Steps, v1Load * 1000.0 / v1Steps);
+	printf("  packed (v2, %2d steps) %8.1f %8.1f %8.1f %8.1f\n", MAX_STEPS, v2Save, v2Load, v2Save * 1000.0 / v2Steps, v2Load * 1000.0 / v2Steps);
+
+	delete target;
+	delete fromV2;
+	delete fromV1;
+	delete source;
+
+	if (errors) {
+		printf("ProgressState: %d fields lost between the array and packed formats\n", errors);
+		return 1;
+	}
+
+	printf("ProgressState: array format loads and saves packed without loss\n");
+	return 0;
+
+}